@@ -0,0 +1,161 @@
+// Sort-key benchmark: state changes per frame for a shuffled scene submitted in insertion order
+// versus radix-sorted by RenderPass. Runs entirely on the CPU; no GL context is created, so the
+// GL names below are fake and are cleared again before the destructors run.
+//
+//   tessera_sort_bench [objects] [programs] [materials] [meshes] [transparent%]
+#define TESSERA_IMPLEMENTATION
+#include "tessera.h"
+
+#include <chrono>
+#include <limits>
+#include <random>
+
+struct Scene {
+  std::vector<Program>    programs;
+  std::vector<Material>   materials;
+  std::vector<Mesh>       meshes;
+  std::vector<Renderable> objects;
+
+  ~Scene() {
+    for (Program& p : programs)
+      p.id = 0;
+    for (Mesh& m : meshes)
+      m.vao = 0;
+  }
+};
+
+static RenderStats countStateChanges(const std::vector<DrawItem>& queue) {
+  RenderStats     stats;
+  const Program*  lastProgram  = nullptr;
+  const Material* lastMaterial = nullptr;
+  const Mesh*     lastMesh     = nullptr;
+
+  for (const DrawItem& item : queue) {
+    if (item.material != lastMaterial) {
+      if (item.material->program != lastProgram)
+        ++stats.programChanges;
+      ++stats.materialChanges;
+      lastProgram  = item.material->program;
+      lastMaterial = item.material;
+    }
+    if (item.object->mesh != lastMesh)
+      ++stats.meshChanges;
+    lastMesh = item.object->mesh;
+    ++stats.draws;
+  }
+  return stats;
+}
+
+static bool transparentOrderIsBackToFront(const std::vector<DrawItem>& queue, const Camera& cam) {
+  float last = std::numeric_limits<float>::max();
+  for (const DrawItem& item : queue) {
+    if (item.material->layer != RenderLayer::Transparent)
+      continue;
+    float d = glm::dot(glm::vec3(item.object->transform[3]) - cam.position, cam.forward());
+    d       = std::clamp(d, cam.nearZ, cam.farZ);
+    // depth is quantized to 24 bits, allow one step of slack
+    if (d > last + (cam.farZ - cam.nearZ) / float(1u << SortKey::kDepthBits))
+      return false;
+    last = d;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  auto arg = [&](int i, size_t fallback) {
+    return argc > i ? static_cast<size_t>(std::strtoull(argv[i], nullptr, 10)) : fallback;
+  };
+  const size_t objectCount   = arg(1, 50000);
+  const size_t programCount  = std::max<size_t>(arg(2, 16), 1);
+  const size_t materialCount = std::max<size_t>(arg(3, 256), 1);
+  const size_t meshCount     = std::max<size_t>(arg(4, 512), 1);
+  const size_t transparentPc = std::min<size_t>(arg(5, 10), 100);
+  constexpr int kFrames      = 100;
+
+  std::mt19937                          rng(1234);
+  std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+
+  Scene scene;
+  scene.programs.resize(programCount);
+  for (size_t i = 0; i < programCount; ++i)
+    scene.programs[i].id = GLuint(i + 1);
+
+  scene.materials.resize(materialCount);
+  for (size_t i = 0; i < materialCount; ++i) {
+    scene.materials[i].program  = &scene.programs[i % programCount];
+    scene.materials[i].pipeline = &gPipelineStates.get(*scene.materials[i].program, {});
+    scene.materials[i].layer =
+        (i * 100 < transparentPc * materialCount) ? RenderLayer::Transparent : RenderLayer::Opaque;
+  }
+
+  scene.meshes.resize(meshCount);
+  for (size_t i = 0; i < meshCount; ++i)
+    scene.meshes[i].vao = scene.meshes[i].sortId = GLuint(i + 1);
+
+  scene.objects.reserve(objectCount);
+  for (size_t i = 0; i < objectCount; ++i) {
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3{pos(rng), pos(rng), pos(rng)});
+    scene.objects.push_back({.mesh      = &scene.meshes[rng() % meshCount],
+                             .material  = &scene.materials[rng() % materialCount],
+                             .transform = transform});
+  }
+
+  Camera camera;
+  camera.position = {0, 0, 600};
+  camera.updateMatrices();
+
+  RenderPass pass{.camera = &camera};
+  for (Renderable& r : scene.objects)
+    pass.objects.push_back(&r);
+
+  auto run = [&](bool sorted) {
+    pass.sortDraws = sorted;
+
+    using clock = std::chrono::steady_clock;
+    auto start  = clock::now();
+    for (int f = 0; f < kFrames; ++f)
+      pass.buildQueue();
+    double usPerFrame =
+        std::chrono::duration<double, std::micro>(clock::now() - start).count() / kFrames;
+
+    RenderStats stats = countStateChanges(pass.queue);
+    std::println("{:>9} | {:>8} {:>9} {:>9} {:>7} {:>8} | {:>9.1f} us",
+                 sorted ? "sorted" : "unsorted",
+                 stats.draws,
+                 stats.programChanges,
+                 stats.materialChanges,
+                 stats.meshChanges,
+                 stats.stateChanges(),
+                 usPerFrame);
+    return stats;
+  };
+
+  std::println("objects={} programs={} materials={} meshes={} transparent={}%",
+               objectCount,
+               programCount,
+               materialCount,
+               meshCount,
+               transparentPc);
+  std::println("{:>9} | {:>8} {:>9} {:>9} {:>7} {:>8} | {:>12}",
+               "order",
+               "draws",
+               "programs",
+               "materials",
+               "meshes",
+               "total",
+               "queue build");
+
+  RenderStats before = run(false);
+  RenderStats after  = run(true);
+
+  std::println("state changes per frame: {} -> {} ({:.1f}x fewer)",
+               before.stateChanges(),
+               after.stateChanges(),
+               double(before.stateChanges()) / std::max(after.stateChanges(), 1u));
+
+  if (!transparentOrderIsBackToFront(pass.queue, camera)) {
+    LOG_ERROR("transparent draws are not sorted back-to-front");
+    return 1;
+  }
+  return 0;
+}
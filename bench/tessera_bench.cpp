@@ -0,0 +1,652 @@
+// Headless stress-scene benchmark. Builds a procedural scene of N meshes x M materials x K
+// instances, renders a fixed number of frames into an offscreen framebuffer on a surfaceless EGL
+// context and prints frame-time percentiles and per-frame GL counters as JSON on stdout.
+//
+//   tessera_bench [--meshes N] [--materials M] [--instances K] [--programs P]
+//                 [--frames F] [--warmup W] [--churn PERCENT] [--seed S]
+//                 [--mode direct|instanced|indirect|gpu] [--size WxH] [--no-sort] [--no-cull]
+//                 [--compile-threads T] [--optimize-meshes] [--quantize] [--meshlets] [--lods]
+//                 [--occlusion]
+//
+// Programs are built through ProgramWarmup before the first frame, on T worker threads with
+// shared contexts (0: the driver's own compiler threads). --optimize-meshes runs the meshes
+// through MeshOptimizer before upload and reports its ACMR/ATVR; --quantize uploads snorm16
+// positions and 16-bit indices through VertexEncoder; --meshlets splits the meshes with
+// MeshletBuilder, culls back faces and, in the indirect and gpu modes, culls per meshlet; --lods
+// adds MeshSimplifier's levels of detail, picked per object from the distance to the camera;
+// --occlusion builds a DepthPyramid from each frame's depth, which the gpu mode's culling tests
+// the next frame against.
+//
+// Runs anywhere Mesa does, e.g. without a GPU:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe tessera_bench --frames 300 > run.json
+// llvmpipe rasterizes on the submitting thread when it has no worker threads (single-core
+// machines, LP_NUM_THREADS=0), which folds raster time into cpu_ms.
+#define TESSERA_IMPLEMENTATION
+#include "tessera.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <chrono>
+#include <numbers>
+#include <random>
+
+// ---- GL call counting ----
+// After RGL_loadGL3 the loader entry points the renderer uses are swapped for counting
+// trampolines. GL 1.1 entry points linked straight from libGL (glBindTexture, glFinish) are not
+// seen.
+static uint64_t gGLCalls = 0;
+
+template <auto& Slot>
+inline std::remove_reference_t<decltype(Slot)> gOriginalProc = nullptr;
+
+template <auto& Slot, typename R, typename... Args>
+R countedProc(Args... args) {
+  ++gGLCalls;
+  return gOriginalProc<Slot>(args...);
+}
+
+template <auto& Slot, typename R, typename... Args>
+void countCalls(R (*)(Args...)) {
+  if (Slot == nullptr) // optional entry points stay null so feature checks still see them missing
+    return;
+  gOriginalProc<Slot> = Slot;
+  Slot                = &countedProc<Slot, R, Args...>;
+}
+
+#define COUNT_GL_CALLS(name) countCalls<name##SRC>(name##SRC)
+
+static void countRendererGLCalls() {
+  COUNT_GL_CALLS(glUseProgram);
+  COUNT_GL_CALLS(glBindVertexArray);
+  COUNT_GL_CALLS(glBindBuffer);
+  COUNT_GL_CALLS(glBindBufferBase);
+  COUNT_GL_CALLS(glBindBufferRange);
+  COUNT_GL_CALLS(glBufferData);
+  COUNT_GL_CALLS(glBufferSubData);
+  COUNT_GL_CALLS(glActiveTexture);
+  COUNT_GL_CALLS(glUniform1i);
+  COUNT_GL_CALLS(glUniform1f);
+  COUNT_GL_CALLS(glUniform4fv);
+  COUNT_GL_CALLS(glUniformMatrix4fv);
+  COUNT_GL_CALLS(glDrawElements);
+  COUNT_GL_CALLS(glDrawElementsBaseVertex);
+  COUNT_GL_CALLS(glDrawElementsInstancedBaseVertex);
+  COUNT_GL_CALLS(glMultiDrawElementsIndirect);
+  COUNT_GL_CALLS(glMultiDrawElementsIndirectCount);
+  COUNT_GL_CALLS(glDispatchCompute);
+  COUNT_GL_CALLS(glMemoryBarrier);
+  COUNT_GL_CALLS(glClearBufferData);
+  COUNT_GL_CALLS(glBindImageTexture);
+  COUNT_GL_CALLS(glTexStorage2D);
+  COUNT_GL_CALLS(glFenceSync);
+  COUNT_GL_CALLS(glClientWaitSync);
+  COUNT_GL_CALLS(glDeleteSync);
+  COUNT_GL_CALLS(glClear);
+}
+
+// ---- headless context ----
+static const EGLint kContextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                         4,
+                                         EGL_CONTEXT_MINOR_VERSION,
+                                         3,
+                                         EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                         EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                         EGL_NONE};
+
+static bool makeSurfacelessContext() {
+  auto getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (!getPlatformDisplay)
+    return false;
+
+  EGLDisplay display =
+      getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    return false;
+
+  eglBindAPI(EGL_OPENGL_API);
+  EGLContext context =
+      eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, kContextAttribs);
+  return context != EGL_NO_CONTEXT &&
+         eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+// Contexts sharing objects with the current one, destroyed when their warm-up worker is done.
+static std::vector<WarmupContext> sharedContexts(size_t count) {
+  EGLDisplay                 display = eglGetCurrentDisplay();
+  std::vector<WarmupContext> contexts;
+  for (size_t i = 0; i < count; ++i) {
+    EGLContext context =
+        eglCreateContext(display, EGL_NO_CONFIG_KHR, eglGetCurrentContext(), kContextAttribs);
+    ASSERT_ALWAYS(context != EGL_NO_CONTEXT && "Failed to create a shared EGL context");
+    contexts.push_back(
+        {.makeCurrent = [=] { eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context); },
+         .release =
+             [=] {
+               eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+               eglDestroyContext(display, context);
+             }});
+  }
+  return contexts;
+}
+
+// Color + depth renderbuffers; a surfaceless context has no default framebuffer.
+struct OffscreenTarget {
+  GLuint fbo   = 0;
+  GLuint color = 0;
+  GLuint depth = 0; // a texture, so DepthPyramid can read it
+
+  OffscreenTarget(GLsizei width, GLsizei height) {
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &color);
+    glGenTextures(1, &depth);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    gGLState.bindTexture(0, GL_TEXTURE_2D, depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    ASSERT_ALWAYS(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glViewport(0, 0, width, height);
+  }
+
+  ~OffscreenTarget() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteTextures(1, &depth);
+    gGLState.forgetTexture(depth);
+  }
+};
+
+// ---- scene ----
+enum class SubmitMode { Direct, Instanced, Indirect, GpuCulled };
+
+struct BenchConfig {
+  size_t     meshes         = 64;
+  size_t     materials      = 32;
+  size_t     instances      = 16;
+  size_t     programs       = 4;
+  size_t     frames         = 200;
+  size_t     warmup         = 20;
+  double     churn          = 1.0; // percent of objects moved and re-materialed per frame
+  uint32_t   seed           = 1234;
+  SubmitMode mode           = SubmitMode::Instanced;
+  GLsizei    width          = 1280;
+  GLsizei    height         = 720;
+  bool       sortDraws      = true;
+  bool       cullObjects    = true;
+  size_t     compileThreads = 0;
+  bool       optimizeMeshes = false;
+  bool       quantize       = false;
+  bool       meshlets       = false;
+  bool       lods           = false;
+  bool       occlusion      = false;
+};
+
+static const char* modeName(SubmitMode mode) {
+  switch (mode) {
+    case SubmitMode::Direct:
+      return "direct";
+    case SubmitMode::Instanced:
+      return "instanced";
+    case SubmitMode::Indirect:
+      return "indirect";
+    case SubmitMode::GpuCulled:
+      return "gpu";
+  }
+  return "unknown";
+}
+
+static std::string vertexSource(SubmitMode mode) {
+  std::string model;
+  switch (mode) {
+    case SubmitMode::Direct:
+      model = "uniform mat4 u_Model;\n"
+              "mat4 model() { return u_Model; }\n";
+      break;
+    case SubmitMode::Instanced:
+      model = "uniform int u_InstanceBase;\n"
+              "mat4 model() { return u_Models[u_InstanceBase + gl_InstanceID]; }\n";
+      break;
+    case SubmitMode::Indirect:
+    case SubmitMode::GpuCulled:
+      model = "layout(location = 15) in uint a_DrawIndex;\n"
+              "mat4 model() { return u_Models[a_DrawIndex]; }\n";
+      break;
+  }
+
+  // the Camera block comes from ProgramPipe::block<CameraBlock>
+  return "#version 430 core\n"
+         "layout(std430, binding = 1) readonly buffer Instances { mat4 u_Models[]; };\n"
+         "layout(location = 0) in vec3 a_Position;\n" +
+         model +
+         "void main() { gl_Position = u_ViewProj * model() * vec4(a_Position, 1.0); }\n";
+}
+
+// Programs only differ by a constant so each one is a distinct GL object.
+static std::string fragmentSource(size_t variant) {
+  return std::format("#version 430 core\n"
+                     "layout(std140, binding = 2) uniform Material {{ vec4 u_Color; }};\n"
+                     "out vec4 FragColor;\n"
+                     "void main() {{ FragColor = u_Color * {:.3f}; }}\n",
+                     1.0 - 0.01 * double(variant));
+}
+
+constexpr VertexAttribute kSphereFormat[] = {{0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0}};
+
+// Unit UV sphere with positions only, generated in place in the arena; segment count varies
+// per mesh. Triangles wind counter-clockwise seen from outside.
+static MeshData sphere(uint32_t segments, MeshArena& arena) {
+  const uint32_t rings    = std::max(segments / 2, 2u);
+  std::span      vertices = arena.allocate<glm::vec3>(size_t(rings + 1) * (segments + 1));
+  std::span      indices  = arena.allocate<GLuint>(size_t(rings) * segments * 6);
+
+  glm::vec3* v = vertices.data();
+  for (uint32_t r = 0; r <= rings; ++r) {
+    float phi = std::numbers::pi_v<float> * float(r) / float(rings);
+    for (uint32_t s = 0; s <= segments; ++s) {
+      float theta = 2.0f * std::numbers::pi_v<float> * float(s) / float(segments);
+      *v++ = {std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)};
+    }
+  }
+  GLuint* i = indices.data();
+  for (uint32_t r = 0; r < rings; ++r) {
+    for (uint32_t s = 0; s < segments; ++s) {
+      GLuint a = r * (segments + 1) + s;
+      GLuint b = a + segments + 1;
+      for (GLuint index : {a, a + 1, b, a + 1, b + 1, b})
+        *i++ = index;
+    }
+  }
+
+  return {std::as_writable_bytes(vertices), indices, kSphereFormat};
+}
+
+struct Scene {
+  GeometryHeap            heap;
+  MeshBatch               batch; // vertex and index storage of the meshes outside the heap
+  std::vector<Mesh>       meshes;
+  std::vector<Program>    programs;
+  std::vector<Material>   materials;
+  std::vector<Renderable> objects;
+  float                   extent = 0.0f; // objects live in [-extent, extent]^3
+  WarmupReport            warmup;
+  MeshOptimizeReport      meshOptimize;
+  MeshSimplifyReport      meshSimplify;
+  size_t                  meshlets = 0;
+};
+
+static glm::mat4 randomTransform(std::mt19937& rng, float extent) {
+  std::uniform_real_distribution<float> pos(-extent, extent);
+  std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+  return glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3{pos(rng), pos(rng), pos(rng)}),
+                    glm::vec3(scale(rng)));
+}
+
+static void buildScene(Scene& scene, const BenchConfig& cfg, std::mt19937& rng) {
+  MeshArena             arena;
+  std::vector<MeshData> meshes;
+  for (size_t i = 0; i < cfg.meshes; ++i)
+    meshes.push_back(sphere(static_cast<uint32_t>(6 + (i % 8) * 2), arena));
+  if (cfg.optimizeMeshes)
+    scene.meshOptimize = MeshOptimizer{}.run(meshes);
+
+  std::vector<std::vector<Meshlet>> meshlets(meshes.size());
+  if (cfg.meshlets)
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      meshlets[i] = MeshletBuilder{}.build(meshes[i]);
+      scene.meshlets += meshlets[i].size();
+    }
+
+  // the first level keeps the meshes' own indices, which the meshlets above index into
+  if (cfg.lods)
+    scene.meshSimplify = MeshSimplifier{}.run(meshes);
+  const std::vector<MeshLods>& lods = scene.meshSimplify.meshes;
+
+  std::vector<MeshView> views;
+  size_t                vertexTotal = 0, indexTotal = 0;
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    const MeshData& mesh = meshes[i];
+    MeshView        view = mesh.view();
+    view.meshlets        = meshlets[i];
+    if (cfg.lods) {
+      view.indices = std::as_bytes(std::span(lods[i].indices));
+      view.lods    = lods[i].levels;
+    }
+    views.push_back(cfg.quantize ? VertexEncoder{}.encode(view, arena) : view);
+    vertexTotal += mesh.vertices.size() / sizeof(glm::vec3);
+    indexTotal += cfg.lods ? lods[i].indices.size() : mesh.indices.size();
+  }
+
+  const bool useHeap = cfg.mode == SubmitMode::Indirect || cfg.mode == SubmitMode::GpuCulled;
+  if (useHeap) {
+    // every sphere shares one vertex format, encoded or not
+    const VertexAttribute& position = views.front().attributes.front();
+    scene.heap = GeometryHeapPipe{}
+                     .attrib(0, 3, position.type, position.normalized, position.stride, 0)
+                     .capacity(vertexTotal, indexTotal)
+                     .build();
+    scene.meshes.reserve(cfg.meshes);
+    for (const MeshView& view : views)
+      scene.meshes.push_back(scene.heap.add(view));
+  } else {
+    scene.batch  = buildMeshes(views);
+    scene.meshes = std::move(scene.batch.meshes);
+  }
+
+  const std::string        vs = vertexSource(cfg.mode);
+  std::vector<WarmupEntry> manifest;
+  scene.programs.resize(cfg.programs);
+  for (size_t i = 0; i < cfg.programs; ++i)
+    manifest.push_back({.name    = std::format("program{}", i),
+                        .pipe    = ProgramPipe{}
+                                    .add(ShaderStage::Vertex, StringSource{vs})
+                                    .add(ShaderStage::Fragment, StringSource{fragmentSource(i)})
+                                    .block<CameraBlock>(0),
+                        .program = &scene.programs[i]});
+  scene.warmup = ProgramWarmup{.contexts = sharedContexts(cfg.compileThreads)}.run(manifest);
+  ASSERT_ALWAYS(scene.warmup.failed == 0 && "Failed to build the bench programs");
+
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  scene.materials.resize(cfg.materials);
+  for (size_t i = 0; i < cfg.materials; ++i) {
+    Material& mat = scene.materials[i];
+    mat.program   = &scene.programs[i % cfg.programs];
+    mat.set("u_Color", glm::vec4{unit(rng), unit(rng), unit(rng), 1.0f});
+    if (cfg.meshlets)
+      mat.state.raster.cullFace = GL_BACK;
+    mat.resolveUniforms();
+  }
+
+  // roughly constant density: ~4 units of space per object along each axis
+  const size_t count = cfg.meshes * cfg.materials * cfg.instances;
+  scene.extent       = 2.0f * std::cbrt(float(count));
+  scene.objects.reserve(count);
+  for (size_t n = 0; n < cfg.meshes; ++n)
+    for (size_t m = 0; m < cfg.materials; ++m)
+      for (size_t k = 0; k < cfg.instances; ++k)
+        scene.objects.push_back({.mesh      = &scene.meshes[n],
+                                 .material  = &scene.materials[m],
+                                 .transform = randomTransform(rng, scene.extent)});
+}
+
+// Moves `percent` of the objects and gives them a random material.
+static void churn(Scene& scene, double percent, std::mt19937& rng) {
+  const size_t moved = static_cast<size_t>(double(scene.objects.size()) * percent / 100.0);
+  for (size_t i = 0; i < moved; ++i) {
+    Renderable& r = scene.objects[rng() % scene.objects.size()];
+    r.transform   = randomTransform(rng, scene.extent);
+    r.material    = &scene.materials[rng() % scene.materials.size()];
+  }
+}
+
+// ---- reporting ----
+struct FrameSample {
+  double      cpuMs;   // RenderPass::render
+  double      frameMs; // render + glFinish
+  RenderStats stats;
+  uint64_t    glCalls;
+  uint32_t    bindsIssued;
+  uint32_t    bindsElided;
+  uint64_t    uploadedBytes;
+};
+
+static std::string percentiles(std::vector<double> ms) {
+  std::ranges::sort(ms);
+  auto at = [&](double p) {
+    return ms[std::min(ms.size() - 1, static_cast<size_t>(p * double(ms.size() - 1) + 0.5))];
+  };
+  double mean = 0.0;
+  for (double v : ms)
+    mean += v;
+  mean /= double(ms.size());
+  return std::format(R"({{"mean": {:.4f}, "p50": {:.4f}, "p90": {:.4f}, )"
+                     R"("p99": {:.4f}, "max": {:.4f}}})",
+                     mean,
+                     at(0.50),
+                     at(0.90),
+                     at(0.99),
+                     ms.back());
+}
+
+template <typename F>
+static double meanOf(const std::vector<FrameSample>& samples, F field) {
+  double sum = 0.0;
+  for (const FrameSample& s : samples)
+    sum += double(field(s));
+  return sum / double(samples.size());
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& cfg) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg   = argv[i];
+    auto             value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : ""; };
+    auto             count = [&]() { return size_t(std::strtoull(value(), nullptr, 10)); };
+
+    if (arg == "--meshes")
+      cfg.meshes = count();
+    else if (arg == "--materials")
+      cfg.materials = count();
+    else if (arg == "--instances")
+      cfg.instances = count();
+    else if (arg == "--programs")
+      cfg.programs = count();
+    else if (arg == "--frames")
+      cfg.frames = count();
+    else if (arg == "--warmup")
+      cfg.warmup = count();
+    else if (arg == "--churn")
+      cfg.churn = std::clamp(std::strtod(value(), nullptr), 0.0, 100.0);
+    else if (arg == "--seed")
+      cfg.seed = static_cast<uint32_t>(count());
+    else if (arg == "--no-sort")
+      cfg.sortDraws = false;
+    else if (arg == "--no-cull")
+      cfg.cullObjects = false;
+    else if (arg == "--compile-threads")
+      cfg.compileThreads = count();
+    else if (arg == "--optimize-meshes")
+      cfg.optimizeMeshes = true;
+    else if (arg == "--quantize")
+      cfg.quantize = true;
+    else if (arg == "--meshlets")
+      cfg.meshlets = true;
+    else if (arg == "--lods")
+      cfg.lods = true;
+    else if (arg == "--occlusion")
+      cfg.occlusion = true;
+    else if (arg == "--size") {
+      int w = 0, h = 0;
+      if (std::sscanf(value(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+        return false;
+      cfg.width  = w;
+      cfg.height = h;
+    } else if (arg == "--mode") {
+      std::string_view mode = value();
+      if (mode == "direct")
+        cfg.mode = SubmitMode::Direct;
+      else if (mode == "instanced")
+        cfg.mode = SubmitMode::Instanced;
+      else if (mode == "indirect")
+        cfg.mode = SubmitMode::Indirect;
+      else if (mode == "gpu")
+        cfg.mode = SubmitMode::GpuCulled;
+      else
+        return false;
+    } else
+      return false;
+  }
+  return cfg.meshes && cfg.materials && cfg.instances && cfg.programs && cfg.frames;
+}
+
+int main(int argc, char** argv) {
+  BenchConfig cfg;
+  if (!parseArgs(argc, argv, cfg)) {
+    std::println(stderr,
+                 "usage: tessera_bench [--meshes N] [--materials M] [--instances K]\n"
+                 "                     [--programs P] [--frames F] [--warmup W]\n"
+                 "                     [--churn PERCENT] [--seed S] [--size WxH]\n"
+                 "                     [--mode direct|instanced|indirect|gpu]\n"
+                 "                     [--no-sort] [--no-cull] [--compile-threads T]\n"
+                 "                     [--optimize-meshes] [--quantize] [--meshlets]\n"
+                 "                     [--lods] [--occlusion]");
+    return 2;
+  }
+
+  ASSERT_ALWAYS(makeSurfacelessContext() && "Failed to create a surfaceless EGL context");
+  ASSERT_ALWAYS(!RGL_loadGL3((RGLloadfunc)eglGetProcAddress) &&
+                "Failed to initialize OpenGL loader");
+  countRendererGLCalls();
+
+  OffscreenTarget target(cfg.width, cfg.height);
+
+  std::mt19937 rng(cfg.seed);
+  Scene        scene;
+  buildScene(scene, cfg, rng);
+
+  Camera camera;
+  camera.aspect         = float(cfg.width) / float(cfg.height);
+  camera.viewportHeight = float(cfg.height);
+  camera.position       = {0.0f, 0.0f, scene.extent};
+
+  RenderPassPipe pipe = RenderPassPipe{}
+                            .camera(&camera)
+                            .frameUniform(FrameUniformPipe{}
+                                              .binding(0)
+                                              .block<CameraBlock>()
+                                              .framesInFlight(3)
+                                              .build())
+                            .add(scene.objects)
+                            .sorted(cfg.sortDraws)
+                            .culling(cfg.cullObjects);
+  const bool useHeap = cfg.mode == SubmitMode::Indirect || cfg.mode == SubmitMode::GpuCulled;
+  if (useHeap)
+    std::move(pipe).indirect(scene.heap).clusterCulling(cfg.meshlets);
+  DepthPyramid pyramid;
+  const bool   occlusion = cfg.occlusion && cfg.mode == SubmitMode::GpuCulled;
+  if (cfg.mode == SubmitMode::GpuCulled)
+    std::move(pipe).gpuCulling(occlusion ? &pyramid : nullptr);
+  RenderPass pass = std::move(pipe).build();
+
+  std::vector<FrameSample> samples;
+  samples.reserve(cfg.frames);
+
+  using clock = std::chrono::steady_clock;
+  for (size_t f = 0; f < cfg.warmup + cfg.frames; ++f) {
+    churn(scene, cfg.churn, rng);
+    if (cfg.churn > 0.0)
+      pass.invalidateObjects();
+    camera.yaw += 0.2f;
+
+    gGLState.resetStats();
+    gGLCalls = 0;
+
+    auto start = clock::now();
+    gGLState.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    pass.render();
+    if (occlusion)
+      pyramid.build(target.depth, cfg.width, cfg.height, camera.viewProj);
+    auto submitted = clock::now();
+    glFinish();
+    auto finished = clock::now();
+
+    if (f < cfg.warmup)
+      continue;
+
+    samples.push_back(
+        {.cpuMs         = std::chrono::duration<double, std::milli>(submitted - start).count(),
+         .frameMs       = std::chrono::duration<double, std::milli>(finished - start).count(),
+         .stats         = pass.stats,
+         .glCalls       = gGLCalls,
+         .bindsIssued   = gGLState.stats.issued(),
+         .bindsElided   = gGLState.stats.elided(),
+         .uploadedBytes = gGLState.stats.uploadedBytes});
+  }
+
+  std::vector<double> cpuMs, frameMs;
+  for (const FrameSample& s : samples) {
+    cpuMs.push_back(s.cpuMs);
+    frameMs.push_back(s.frameMs);
+  }
+
+  const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  std::println("{{");
+  std::println(R"(  "renderer": "{}",)", renderer ? renderer : "unknown");
+  std::println(R"(  "config": {{"meshes": {}, "materials": {}, "instances": {}, "programs": {}, )"
+               R"("objects": {}, "frames": {}, "warmup": {}, "churn": {}, "mode": "{}", )"
+               R"("width": {}, "height": {}, "sorted": {}, "culled": {}, "quantized": {}, )"
+               R"("meshlets": {}, "lods": {}, "occlusion": {}}},)",
+               cfg.meshes,
+               cfg.materials,
+               cfg.instances,
+               cfg.programs,
+               scene.objects.size(),
+               cfg.frames,
+               cfg.warmup,
+               cfg.churn,
+               modeName(cfg.mode),
+               cfg.width,
+               cfg.height,
+               cfg.sortDraws ? "true" : "false",
+               cfg.cullObjects ? "true" : "false",
+               cfg.quantize ? "true" : "false",
+               scene.meshlets,
+               scene.meshSimplify.levels,
+               occlusion ? "true" : "false");
+  double buildMs = 0.0, primeMs = 0.0;
+  for (const WarmupTiming& program : scene.warmup.programs) {
+    buildMs += program.buildMs;
+    primeMs += program.primeMs;
+  }
+  std::println(R"(  "program_warmup": {{"threads": {}, "total_ms": {:.2f}, "build_ms": {:.2f}, )"
+               R"("prime_ms": {:.2f}}},)",
+               cfg.compileThreads,
+               scene.warmup.totalMs,
+               buildMs,
+               primeMs);
+  if (cfg.optimizeMeshes)
+    std::println(R"(  "mesh_optimize": {{"acmr_before": {:.3f}, "acmr_after": {:.3f}, )"
+                 R"("atvr_before": {:.3f}, "atvr_after": {:.3f}, "total_ms": {:.2f}}},)",
+                 scene.meshOptimize.acmrBefore,
+                 scene.meshOptimize.acmrAfter,
+                 scene.meshOptimize.atvrBefore,
+                 scene.meshOptimize.atvrAfter,
+                 scene.meshOptimize.totalMs);
+  if (cfg.lods)
+    std::println(R"(  "mesh_simplify": {{"levels": {}, "triangles": {}, )"
+                 R"("coarsest_triangles": {}, "total_ms": {:.2f}}},)",
+                 scene.meshSimplify.levels,
+                 scene.meshSimplify.triangles,
+                 scene.meshSimplify.coarsestTriangles,
+                 scene.meshSimplify.totalMs);
+  std::println(R"(  "cpu_ms": {},)", percentiles(cpuMs));
+  std::println(R"(  "frame_ms": {},)", percentiles(frameMs));
+  std::println(R"(  "per_frame": {{"culled": {:.1f}, "clusters_culled": {:.1f}, )"
+               R"("draws": {:.1f}, "draw_calls": {:.1f}, "triangles": {:.1f}, )"
+               R"("gl_calls": {:.1f}, "state_changes": {:.1f}, "program_changes": {:.1f}, )"
+               R"("material_changes": {:.1f}, "mesh_changes": {:.1f}, "binds_issued": {:.1f}, )"
+               R"("binds_elided": {:.1f}, "bytes_uploaded": {:.1f}}})",
+               meanOf(samples, [](const FrameSample& s) { return s.stats.culled; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.clustersCulled; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.draws; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.drawCalls; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.triangles; }),
+               meanOf(samples, [](const FrameSample& s) { return s.glCalls; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.stateChanges(); }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.programChanges; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.materialChanges; }),
+               meanOf(samples, [](const FrameSample& s) { return s.stats.meshChanges; }),
+               meanOf(samples, [](const FrameSample& s) { return s.bindsIssued; }),
+               meanOf(samples, [](const FrameSample& s) { return s.bindsElided; }),
+               meanOf(samples, [](const FrameSample& s) { return s.uploadedBytes; }));
+  std::println("}}");
+
+  return glGetError() == GL_NO_ERROR ? 0 : 1;
+}
@@ -1,73 +1,5 @@
 // #includc> <GL/gl.h>
 // #include <GLES3/gl3.h>
-#include <cstdlib>
-#include <format>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/mat4x4.hpp> // glm::mat4
-#include <glm/vec3.hpp>   // glm::vec3
-#include <glm/vec4.hpp>   // glm::vec4
-#include <print>
-#include <unordered_map>
-#include <utility>
-//
-#define LOGF_INFO(fmt, ...)                                                                        \
-  logMessage(LogLevel::Info, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
-#define LOGF_WARN(fmt, ...)                                                                        \
-  logMessage(LogLevel::Warning, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
-
-#define LOGF_ERROR(fmt, ...)                                                                       \
-  logMessage(LogLevel::Error, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
-
-#define LOG_INFO(msg) logMessage(LogLevel::Info, msg, __FILE__, __LINE__)
-#define LOG_WARN(msg) logMessage(LogLevel::Warning, msg, __FILE__, __LINE__)
-
-#define LOG_ERROR(msg) logMessage(LogLevel::Error, msg, __FILE__, __LINE__)
-
-enum class LogLevel { Info, Warning, Error };
-
-inline void logMessage(LogLevel level, std::string_view message, const char* file, int line) {
-  const char* levelStr = level == LogLevel::Info      ? "INFO"
-                         : level == LogLevel::Warning ? "WARN"
-                                                      : "ERROR";
-
-  std::println(stderr, "[{}] {} ({}:{})", levelStr, message, file, line);
-}
-
-#ifdef NDEBUG
-
-#  define ASSERT(cond) ((void)0)
-
-#else
-
-#  include <cstdlib>
-
-#  define ASSERT(cond)                                                                             \
-    do {                                                                                           \
-      if (!(cond)) {                                                                               \
-        logMessage(LogLevel::Error, "ASSERT FAILED: " #cond, __FILE__, __LINE__);                  \
-        std::abort();                                                                              \
-      }                                                                                            \
-    } while (0)
-
-#endif
-
-#include <cstdlib>
-
-#define ASSERT_ALWAYS(cond)                                                                        \
-  do {                                                                                             \
-    if (!(cond)) {                                                                                 \
-      logMessage(LogLevel::Error, "ASSERT_ALWAYS FAILED: " #cond, __FILE__, __LINE__);             \
-      std::abort();                                                                                \
-    }                                                                                              \
-  } while (0)
-
-#define CHECK(cond, fmt, ...)                                                                      \
-  do {                                                                                             \
-    if (!(cond)) {                                                                                 \
-      LOGF_WARN("CHECK FAILED: {}: " fmt, #cond, ##__VA_ARGS__);                                   \
-    }                                                                                              \
-  } while (0)
-
 #define RGFW_OPENGL
 // #undec> RGFW_X11
 #define RGFW_WAYLAND
@@ -81,74 +13,8 @@ inline void logMessage(LogLevel level, std::string_view message, const char* fil
   extern "C" {
     #include "RGFW.h"
   }
-#ifdef RGFW_MACOS
-#  include <OpenGL/gl.h>
-#else
-#  include <GL/gl.h>
-#endif
-#ifndef __EMSCRIPTEN__
-#  define RGL_LOAD_IMPLEMENTATION
-#  include "rglLoad.h"
-#else
-#  include <GLES3/gl3.h>
-#endif
-
-void APIENTRY glDebugCallback(GLenum        source,
-                              GLenum        type,
-                              GLuint        id,
-                              GLenum        severity,
-                              GLsizei       length,
-                              const GLchar* message,
-                              const void*   userParam) {
-  std::string_view src = source == GL_DEBUG_SOURCE_API               ? "API"
-                         : source == GL_DEBUG_SOURCE_SHADER_COMPILER ? "SHADER"
-                         : source == GL_DEBUG_SOURCE_WINDOW_SYSTEM   ? "WINDOW"
-                         : source == GL_DEBUG_SOURCE_THIRD_PARTY     ? "3RD PARTY"
-                         : source == GL_DEBUG_SOURCE_APPLICATION     ? "APP"
-                                                                     : "OTHER";
-
-  std::string_view msg(message);
-
-  switch (severity) {
-    case GL_DEBUG_SEVERITY_HIGH:
-      // Something is seriously wrong — UB or crash likely
-      logMessage(LogLevel::Error,
-                 std::string("GL HIGH : ") + std::string(src) + " : " + std::string(msg),
-                 __FILE__,
-                 __LINE__);
-      // std::abort();
-
-    case GL_DEBUG_SEVERITY_MEDIUM:
-      logMessage(LogLevel::Error,
-                 std::string("GL MEDIUM : ") + std::string(src) + " : " + std::string(msg),
-                 __FILE__,
-                 __LINE__);
-      break;
-
-    case GL_DEBUG_SEVERITY_LOW:
-      logMessage(LogLevel::Warning,
-                 std::string("GL LOW : ") + std::string(src) + " : " + std::string(msg),
-                 __FILE__,
-                 __LINE__);
-      break;
-
-    case GL_DEBUG_SEVERITY_NOTIFICATION:
-      // Optional — often spammy
-      logMessage(LogLevel::Info, msg, __FILE__, __LINE__);
-      break;
-  }
-}
-void enableOpenGLDebug() {
-  glEnable(GL_DEBUG_OUTPUT);
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-
-  glDebugMessageCallback(glDebugCallback, nullptr);
-
-  //  filter out notifications
-  // glDebugMessageControl(GL_DONT_CARE,  GL_DONT_CARE,
-  //                       GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr,
-  //                       GL_FALSE);
-}
+#define TESSERA_IMPLEMENTATION
+#include "tessera.h"
 
 constexpr const char* RGFWDebugToString(RGFW_debugType type) {
   switch (type) {
@@ -250,653 +116,24 @@ void engineRGFWDebugCallback(RGFW_debugType type, RGFW_errorCode err, const char
   }
 }
 
-#define MULTILINE_STR(...) #__VA_ARGS__
-#define GLSL(code) R"GLSL(code)GLSL"
-#define CONCAT_IMPL(x, y) x##y
-#define CONCAT(x, y) CONCAT_IMPL(x, y)
-
-#define defer(code) auto CONCAT(_defer_, __LINE__) = ScopeExit([&]() { code; })
-template <typename F>
-struct ScopeExit {
-  F f;
-  ScopeExit(F&& f) : f(std::forward<F>(f)) {}
-  ~ScopeExit() { f(); }
-};
-
-#include <fstream>
-#include <sstream>
-#include <stdbool.h>
-#include <stdexcept>
-#include <string>
-#include <variant>
-#include <vector>
-
-enum class ShaderStage { Vertex, Fragment, Geometry, Compute, TessControl, TessEval };
-
-struct FileSource {
-  std::string path;
-};
-
-struct StringSource {
-  std::string code;
-};
-
-struct EmbeddedSource {
-  const char* code;
-};
-
-struct VertexAttribute {
-  GLuint    location;
-  GLint     size;
-  GLenum    type;
-  GLboolean normalized;
-  GLsizei   stride;
-  size_t    offset;
-};
-
-struct BufferData {
-  GLenum                 target;
-  std::vector<std::byte> bytes;
-};
-
-struct MeshSpec {
-  std::vector<BufferData>      buffers;
-  std::vector<VertexAttribute> attributes;
-  GLsizei                      indexCount = 0;
-};
-
-struct Mesh {
-  GLuint  vao        = 0;
-  GLuint  vbo        = 0;
-  GLuint  ebo        = 0;
-  GLsizei indexCount = 0;
-
-  Mesh() = default;
-
-  Mesh(const Mesh&)            = delete;
-  Mesh& operator=(const Mesh&) = delete;
-
-  Mesh(Mesh&& other) noexcept { *this = std::move(other); }
-
-  Mesh& operator=(Mesh&& other) noexcept {
-    destroy();
-    vao        = other.vao;
-    vbo        = other.vbo;
-    ebo        = other.ebo;
-    indexCount = other.indexCount;
-
-    other.vao = other.vbo = other.ebo = 0;
-    other.indexCount                  = 0;
-    return *this;
-  }
-
-  void draw() const {
-    ASSERT_ALWAYS(vao != 0);
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
-  }
-
-  void setDebugName(const char* name) {
-    glObjectLabel(GL_VERTEX_ARRAY, vao, -1, name);
-    glObjectLabel(GL_BUFFER, vbo, -1, "VBO");
-    glObjectLabel(GL_BUFFER, ebo, -1, "EBO");
-  }
-  ~Mesh() { destroy(); }
-
-  void destroy() {
-    if (vao)
-      glDeleteVertexArrays(1, &vao);
-    if (vbo)
-      glDeleteBuffers(1, &vbo);
-    if (ebo)
-      glDeleteBuffers(1, &ebo);
-
-    vao = vbo = ebo = 0;
-    indexCount      = 0;
-  }
-};
-struct Program {
-  GLuint id = 0;
-
-  Program() = default;
-  explicit Program(GLuint id) : id(id) {}
-
-  Program(const Program&)            = delete;
-  Program& operator=(const Program&) = delete;
-
-  Program(Program&& other) noexcept { *this = std::move(other); }
-
-  Program& operator=(Program&& other) noexcept {
-    destroy();
-    id       = other.id;
-    other.id = 0;
-    return *this;
-  }
-
-  ~Program() { destroy(); }
-
-  void destroy() {
-    if (id) {
-      glDeleteProgram(id);
-      id = 0;
-    }
-  }
-  void use() const { glUseProgram(id); }
-
-  void setDebugName(const char* name) { glObjectLabel(GL_PROGRAM, id, -1, name); }
-  // ---- uniform setters ----
-  void set(const char* name, int v) const { glUniform1i(uniformLocation(name), v); }
-
-  void set(const char* name, float v) const { glUniform1f(uniformLocation(name), v); }
-
-  void setVec4(const char* name, const float* v) const {
-    glUniform4fv(uniformLocation(name), 1, v);
-  }
-
-  void setMat4(const char* name, const float* m) const {
-    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, m);
-  }
-
-  mutable std::unordered_map<std::string, GLint> uniformCache;
-
-  GLint uniformLocation(const char* name) const {
-    auto it = uniformCache.find(name);
-    if (it != uniformCache.end())
-      return it->second;
-
-    GLint loc = glGetUniformLocation(id, name);
-
-    CHECK(loc != -1, "Uniform not found ({})", name);
-    uniformCache[name] = loc;
-    return loc;
-  }
-};
-
-struct MeshPipe {
-  MeshSpec spec;
-
-  MeshPipe addVBO(const void* data, size_t size) const {
-    MeshPipe next = *this;
-    next.spec.buffers.push_back(
-        {GL_ARRAY_BUFFER,
-         std::vector<std::byte>(static_cast<const std::byte*>(data),
-                                static_cast<const std::byte*>(data) + size)});
-    return next;
-  }
-
-  MeshPipe addEBO(const void* data, size_t size, GLsizei indexCount) const {
-    MeshPipe next = *this;
-    next.spec.buffers.push_back(
-        {GL_ELEMENT_ARRAY_BUFFER,
-         std::vector<std::byte>(static_cast<const std::byte*>(data),
-                                static_cast<const std::byte*>(data) + size)});
-    next.spec.indexCount = indexCount;
-    return next;
-  }
-
-  MeshPipe attrib(GLuint    location,
-                  GLint     size,
-                  GLenum    type,
-                  GLboolean normalized,
-                  GLsizei   stride,
-                  size_t    offset) const {
-    MeshPipe next = *this;
-    next.spec.attributes.push_back({location, size, type, normalized, stride, offset});
-    return next;
-  }
-};
-
-Mesh buildMesh(const MeshSpec& spec) {
-  Mesh mesh{};
-  glGenVertexArrays(1, &mesh.vao);
-  glBindVertexArray(mesh.vao);
-
-  for (const auto& buf : spec.buffers) {
-    GLuint id;
-    glGenBuffers(1, &id);
-    glBindBuffer(buf.target, id);
-    glBufferData(buf.target, buf.bytes.size(), buf.bytes.data(), GL_STATIC_DRAW);
-
-    if (buf.target == GL_ARRAY_BUFFER)
-      mesh.vbo = id;
-    else if (buf.target == GL_ELEMENT_ARRAY_BUFFER)
-      mesh.ebo = id;
-  }
-
-  for (const auto& attr : spec.attributes) {
-    glVertexAttribPointer(attr.location,
-                          attr.size,
-                          attr.type,
-                          attr.normalized,
-                          attr.stride,
-                          reinterpret_cast<void*>(attr.offset));
-    glEnableVertexAttribArray(attr.location);
-  }
-
-  glBindVertexArray(0);
-
-  mesh.indexCount = spec.indexCount;
-  return mesh;
-}
-
-using ShaderSource = std::variant<FileSource, StringSource, EmbeddedSource>;
-
-struct ShaderSpec {
-  ShaderStage  stage;
-  ShaderSource source;
-};
-
-using ShaderPipeline = std::vector<ShaderSpec>;
-
-constexpr GLenum toGLenum(ShaderStage stage) {
-  switch (stage) {
-    case ShaderStage::Vertex:
-      return GL_VERTEX_SHADER;
-    case ShaderStage::Fragment:
-      return GL_FRAGMENT_SHADER;
-    case ShaderStage::Geometry:
-      return GL_GEOMETRY_SHADER;
-    case ShaderStage::Compute:
-      return GL_COMPUTE_SHADER;
-    case ShaderStage::TessControl:
-      return GL_TESS_CONTROL_SHADER;
-    case ShaderStage::TessEval:
-      return GL_TESS_EVALUATION_SHADER;
-  }
-  throw std::logic_error("Unhandled ShaderStage");
-}
-
-static std::string readFile(const std::string& path) {
-  std::ifstream file(path);
-  if (!file)
-    throw std::runtime_error("Failed to open shader file: " + path);
-
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
-}
-
-static GLuint compileShader(GLenum type, const std::string& source) {
-  GLuint      shader = glCreateShader(type);
-  const char* src    = source.c_str();
-
-  glShaderSource(shader, 1, &src, nullptr);
-  glCompileShader(shader);
-
-  GLint ok = 0;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
-
-  if (!ok) {
-    GLint len = 0;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
-
-    std::string log(len, '\0');
-    glGetShaderInfoLog(shader, len, nullptr, log.data());
-
-    glDeleteShader(shader);
-    throw std::runtime_error("Shader compile error:\n" + log);
-  }
-
-  return shader;
-}
-struct ShaderModule {
-  GLuint      id = 0;
-  ShaderStage stage;
-
-  ShaderModule(GLuint id, ShaderStage stage) : id(id), stage(stage) {}
-
-  ShaderModule(const ShaderModule&)            = delete;
-  ShaderModule& operator=(const ShaderModule&) = delete;
-
-  ShaderModule(ShaderModule&& other) noexcept : id(other.id), stage(other.stage) { other.id = 0; }
-
-  ~ShaderModule() {
-    if (id)
-      glDeleteShader(id);
-  }
-};
-
-template <typename>
-inline constexpr bool always_false = false;
-struct ShaderLoader {
-  static ShaderModule load(ShaderStage stage, const ShaderSource& source) {
-    GLuint shader = std::visit(
-        [glStage = toGLenum(stage)](auto&& src) -> GLuint {
-          using T = std::decay_t<decltype(src)>;
-
-          if constexpr (std::is_same_v<T, FileSource>)
-            return compileShader(glStage, readFile(src.path));
-
-          else if constexpr (std::is_same_v<T, StringSource>)
-            return compileShader(glStage, src.code);
-
-          else if constexpr (std::is_same_v<T, EmbeddedSource>)
-            return compileShader(glStage, src.code);
-
-          else
-            static_assert(always_false<T>, "Unhandled ShaderSource");
-        },
-        source);
-
-    return ShaderModule{shader, stage};
-  }
-};
-struct ProgramPipe {
-  ShaderPipeline pipeline;
-
-  ProgramPipe add(ShaderStage stage, ShaderSource source) const {
-    ProgramPipe next = *this;
-    next.pipeline.push_back({stage, std::move(source)});
-    return next;
-  }
-
-  Program build() const {
-    if (pipeline.empty())
-      throw std::runtime_error("ProgramPipe: empty pipeline");
-
-    GLuint              program = glCreateProgram();
-    std::vector<GLuint> shaders;
-    shaders.reserve(pipeline.size());
-
-    // compile + attach
-    for (const auto& spec : pipeline) {
-      ShaderModule mod = ShaderLoader::load(spec.stage, spec.source);
-      glAttachShader(program, mod.id);
-      shaders.push_back(mod.id);
-    }
-
-    glLinkProgram(program);
-
-    GLint success = 0;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-      GLint len = 0;
-      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
-      std::string log(len, '\0');
-      glGetProgramInfoLog(program, len, nullptr, log.data());
-
-      for (GLuint s : shaders)
-        glDeleteShader(s);
-
-      glDeleteProgram(program);
-      throw std::runtime_error("Program link error:\n" + log);
-    }
-
-    // shaders no longer needed
-    // foc> (GLuint s : shaders) {
-    //   glDetachShader(program, s);
-    //   glDeleteShader(s);
-    // }
-    //
-    return Program{program}; // RAII object
-  }
-};
-using UniformValue = std::variant<int, float, glm::vec4, glm::mat4>;
-
-struct TextureBinding {
-  GLuint texture;
-  GLenum target;
-  GLuint unit;
-};
-struct CachedUniform {
-  GLint        location = -1;
-  UniformValue value;
-};
-
-struct Material {
-  Program*                                       program; // non-owning reference
-  std::unordered_map<std::string, CachedUniform> uniforms;
-  std::vector<TextureBinding>                    textures;
-
-  void set(const std::string& name, UniformValue value) { uniforms[name].value = std::move(value); }
-
-  void resolveUniforms() {
-    ASSERT_ALWAYS(program);
-
-    for (auto& [name, u] : uniforms) {
-      u.location = program->uniformLocation(name.c_str());
-
-#ifndef NDEBUG
-      if (u.location == -1) {
-        LOGF_WARN("Uniform '{}' not found in program {}", name, program->id);
-      }
-#endif
-    }
-  }
-
-  void bind() const {
-    ASSERT_ALWAYS(program);
-    program->use();
-
-    for (const auto& [_, u] : uniforms) {
-      if (u.location == -1)
-        continue;
-
-      std::visit(
-          [&](auto&& v) {
-            using T = std::decay_t<decltype(v)>;
-
-            if constexpr (std::is_same_v<T, int>)
-              glUniform1i(u.location, v);
-
-            else if constexpr (std::is_same_v<T, float>)
-              glUniform1f(u.location, v);
-
-            else if constexpr (std::is_same_v<T, glm::vec4>)
-              glUniform4fv(u.location, 1, glm::value_ptr(v));
-
-            else if constexpr (std::is_same_v<T, glm::mat4>)
-              glUniformMatrix4fv(u.location, 1, GL_FALSE, glm::value_ptr(v));
-          },
-          u.value);
-    }
-
-    for (const auto& t : textures) {
-      glActiveTexture(GL_TEXTURE0 + t.unit);
-      glBindTexture(t.target, t.texture);
-    }
-  }
-};
-
-struct Renderable {
-  const Mesh*     mesh     = nullptr;
-  const Material* material = nullptr;
-  glm::mat4       transform;
-
-  void draw() const {
-    ASSERT(mesh);
-    ASSERT(material);
-
-    material->bind();
-
-    // per-object uniforms
-    material->program->setMat4("u_Model", glm::value_ptr(transform));
-
-    mesh->draw();
-  }
-};
-
-struct Camera {
-  glm::vec3 position{0, 0, 3};
-
-  float yaw   = -90.0f; // degrees
-  float pitch = 0.0f;
-
-  float fov    = 60.0f; // degrees
-  float aspect = 16.0f / 9.0f;
-  float nearZ  = 0.1f;
-  float farZ   = 1000.0f;
-
-  glm::mat4 view;
-  glm::mat4 proj;
-  glm::mat4 viewProj;
-
-  void updateMatrices() {
-    glm::vec3 forward{cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
-                      sin(glm::radians(pitch)),
-                      sin(glm::radians(yaw)) * cos(glm::radians(pitch))};
-
-    glm::vec3 target = position + normalize(forward);
-    view             = glm::lookAt(position, target, glm::vec3{0, 1, 0});
-    proj             = glm::perspective(glm::radians(fov), aspect, nearZ, farZ);
-    viewProj         = proj * view;
-  }
-  glm::vec3 forward() const {
-    return glm::normalize(glm::vec3{cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
-                                    sin(glm::radians(pitch)),
-                                    sin(glm::radians(yaw)) * cos(glm::radians(pitch))});
-  }
-
-  glm::vec3 right() const { return glm::normalize(glm::cross(forward(), glm::vec3{0, 1, 0})); }
-};
-
-struct FrameUniform {
-  GLuint buffer  = 0;
-  GLuint binding = 0;
-  size_t size    = 0;
-
-  FrameUniform() = default;
-  FrameUniform(GLuint buffer, GLuint binding, size_t size) :
-      buffer(buffer), binding(binding), size(size) {}
-
-  FrameUniform(const FrameUniform&)            = delete;
-  FrameUniform& operator=(const FrameUniform&) = delete;
-
-  FrameUniform(FrameUniform&& other) noexcept { *this = std::move(other); }
-
-  FrameUniform& operator=(FrameUniform&& other) noexcept {
-    destroy();
-    buffer       = other.buffer;
-    binding      = other.binding;
-    size         = other.size;
-    other.buffer = 0;
-    return *this;
-  }
-
-  void update(const void* data, size_t bytes, size_t offset = 0) const {
-    ASSERT_ALWAYS(buffer);
-    ASSERT_ALWAYS(offset + bytes <= size);
-    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-    glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data);
-  }
-
-  void destroy() {
-    if (buffer)
-      glDeleteBuffers(1, &buffer);
-    buffer = 0;
-  }
-
-  ~FrameUniform() { destroy(); }
-};
-struct FrameUniformSpec {
-  GLuint binding = 0;
-  size_t size    = 0;
-};
-struct FrameUniformPipe {
-  FrameUniformSpec spec;
-
-  FrameUniformPipe binding(GLuint b) const {
-    FrameUniformPipe next = *this;
-    next.spec.binding     = b;
-    return next;
-  }
-
-  FrameUniformPipe size(size_t s) const {
-    FrameUniformPipe next = *this;
-    next.spec.size        = s;
-    return next;
-  }
-
-  FrameUniform build() const {
-    ASSERT_ALWAYS(spec.size > 0);
-
-    GLuint ubo = 0;
-    glGenBuffers(1, &ubo);
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-    glBufferData(GL_UNIFORM_BUFFER, spec.size, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, spec.binding, ubo);
-
-    return FrameUniform{ubo, spec.binding, spec.size};
-  }
-};
-struct RenderPassSpec {
-  Camera*                  camera = nullptr;
-  FrameUniform             frameUniform;
-  std::vector<Renderable*> objects;
-};
-
-struct RenderPass {
-  Camera*      camera = nullptr;
-  FrameUniform frameUniform;
-
-  std::vector<Renderable*> objects;
-
-  void render() {
-    ASSERT(camera);
-
-    camera->updateMatrices();
-    frameUniform.update(glm::value_ptr(camera->viewProj), sizeof(glm::mat4));
-
-    for (Renderable* r : objects)
-      r->draw();
-  }
-};
-struct RenderPassPipe {
-  RenderPassSpec spec;
-
-  RenderPassPipe()                            = default;
-  RenderPassPipe(RenderPassPipe&&)            = default;
-  RenderPassPipe& operator=(RenderPassPipe&&) = default;
-
-  RenderPassPipe(const RenderPassPipe&)            = delete;
-  RenderPassPipe& operator=(const RenderPassPipe&) = delete;
-
-  RenderPassPipe&& camera(Camera* cam) && {
-    spec.camera = cam;
-    return std::move(*this);
-  }
-
-  RenderPassPipe&& frameUniform(FrameUniform&& fu) && {
-    spec.frameUniform = std::move(fu);
-    return std::move(*this);
-  }
-
-  RenderPassPipe&& add(Renderable& r) && {
-    spec.objects.push_back(&r);
-    return std::move(*this);
-  }
-
-  RenderPassPipe&& add(std::span<Renderable> rs) && {
-    for (auto& r : rs)
-      spec.objects.push_back(&r);
-    return std::move(*this);
-  }
-
-  RenderPass build() && {
-    ASSERT_ALWAYS(spec.camera);
-    ASSERT_ALWAYS(spec.frameUniform.buffer);
-
-    return RenderPass{.camera       = spec.camera,
-                      .frameUniform = std::move(spec.frameUniform),
-                      .objects      = std::move(spec.objects)};
-  }
-};
-
 // settings
 const int SCR_WIDTH  = 1920;
 const int SCR_HEIGHT = 1080;
 
+// the Camera block is declared by ProgramPipe::block<CameraBlock>
+constexpr GLuint      cameraBinding      = 0;
 constexpr const char* vertexShaderSource = R"GLSL(
 #version 430 core
-layout(std140, binding = 0) uniform Camera {
-  mat4 u_ViewProj;
+layout(std430, binding = 1) readonly buffer Instances {
+  mat4 u_Models[];       // object transforms, streamed per frame
 };
 layout (location = 0) in vec3 a_Position;
 
-uniform mat4 u_Model;    // object transform (per-draw)
+uniform int u_InstanceBase; // first transform of this instanced run
 
 void main() {
-    gl_Position = u_ViewProj * u_Model * vec4(a_Position, 1.0);
+    mat4 model  = u_Models[u_InstanceBase + gl_InstanceID];
+    gl_Position = u_ViewProj * model * vec4(a_Position, 1.0);
 }
 )GLSL";
 
@@ -908,12 +145,25 @@ constexpr const char* fragmentShaderSource = R"GLSL(
 
 out vec4 FragColor;
 
-uniform vec4 u_Color; // material color
+layout(std140, binding = 2) uniform Material {
+  vec4 u_Color; // material color
+};
 
 void main() {
     FragColor = u_Color;
 }
 )GLSL";
+
+// flat stand-in drawn while the real program links in the background
+constexpr const char* fallbackFragmentSource = R"GLSL(
+#version 430 core
+
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
+)GLSL";
 static Camera*        gCamera              = nullptr;
 void                  mousePosCallback(RGFW_window* w, int x, int y, float dx, float dy) {
   if (!gCamera)
@@ -964,46 +214,69 @@ int main(void) {
 
   std::vector<Renderable> renderQueue;
   Camera                  camera;
-  gCamera = &camera;
+  camera.viewportHeight = SCR_HEIGHT;
+  gCamera               = &camera;
 
   // RGFW_mousePosCallbackSrc = mousePosCallback;
 
   RGFW_setMousePosCallback(mousePosCallback);
 
+  // linked programs from previous runs; rewritten on exit when something new was compiled
+  ProgramCache programCache("program_cache.bin");
+
+  Program fallbackProgram = ProgramPipe{}
+                                .add(ShaderStage::Vertex, EmbeddedSource{vertexShaderSource})
+                                .add(ShaderStage::Fragment, EmbeddedSource{fallbackFragmentSource})
+                                .block<CameraBlock>(cameraBinding)
+                                .cache(programCache)
+                                .build();
+  defer(fallbackProgram.destroy());
+
   Program shaderProgram = ProgramPipe{}
                               .add(ShaderStage::Vertex, EmbeddedSource{vertexShaderSource})
                               .add(ShaderStage::Fragment, EmbeddedSource{fragmentShaderSource})
-                              .build();
+                              .block<CameraBlock>(cameraBinding)
+                              .cache(programCache)
+                              .buildAsync();
   // optional
   defer(shaderProgram.destroy());
 
+  Material fallbackMat;
+  fallbackMat.program = &fallbackProgram;
+  fallbackMat.resolveUniforms();
 
   Material mat;
-  mat.program = &shaderProgram;
+  mat.program  = &shaderProgram;
+  mat.fallback = &fallbackMat;
   mat.set("u_Color", glm::vec4{1, 0.9f, 0.2f, 1});
-  mat.resolveUniforms();
+  mat.resolveUniforms(); // deferred until shaderProgram links
 
   // --- Mesh data ---
   float vertices[] = {0.5f, 0.5f, 0.0f, 0.5f, -0.5f, 0.0f, -0.5f, -0.5f, 0.0f, -0.5f, 0.5f, 0.0f};
 
   unsigned int indices[] = {0, 1, 3, 1, 2, 3};
 
-  Mesh quad = buildMesh(MeshPipe{}
-                            .addVBO(vertices, sizeof(vertices))
-                            .addEBO(indices, sizeof(indices), 6)
-                            .attrib(0, // location
-                                    3, // vec3
-                                    GL_FLOAT,
-                                    GL_FALSE,
-                                    3 * sizeof(float),
-                                    0)
-                            .spec);
+  MeshSpec quadSpec = MeshPipe{}
+                         .addVBO(vertices, sizeof(vertices))
+                         .addEBO(indices, sizeof(indices), 6)
+                         .attrib(0, // location
+                                 3, // vec3
+                                 GL_FLOAT,
+                                 GL_FALSE,
+                                 3 * sizeof(float),
+                                 0)
+                         .spec;
+
+  // snorm16 positions and 16-bit indices; the position decode rides on the model matrix
+  MeshArena encoded;
+  Mesh      quad = buildMesh(VertexEncoder{}.encode(viewOf(quadSpec), encoded));
   // optional
   defer(quad.destroy());
 
   renderQueue.push_back({.mesh = &quad, .material = &mat, .transform = glm::identity<glm::mat4>()});
 
-  FrameUniform cameraViewUniform = FrameUniformPipe{}.binding(0).size(sizeof(glm::mat4)).build();
+  FrameUniform cameraViewUniform =
+      FrameUniformPipe{}.binding(cameraBinding).block<CameraBlock>().framesInFlight(3).build();
 
   RenderPass pass = RenderPassPipe{}
                         .camera(&camera)
@@ -1054,7 +327,13 @@ int main(void) {
       camera.position.y -= speed;
 
     // LOGF_INFO("camera pos {} {}", camera.position.x, camera.position.y);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!mat.ready() && mat.poll())
+      LOGF_INFO("program cache: {} hits, {} misses, {} rejected",
+                programCache.stats.hits,
+                programCache.stats.misses,
+                programCache.stats.rejected);
+
+    gGLState.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     pass.render();
 
     RGFW_window_swapBuffers_OpenGL(window);
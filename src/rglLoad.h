@@ -196,49 +196,226 @@ typedef void (*glObjectLabelPROC)(GLenum      identifier,
                                   GLsizei     length,
                                   const char* label);
 typedef void (*glBindBufferBasePROC)(GLenum target, GLuint index, GLuint buffer);
+typedef void (*glDrawElementsInstancedPROC)(GLenum      mode,
+                                            GLsizei     count,
+                                            GLenum      type,
+                                            const void* indices,
+                                            GLsizei     instancecount);
+typedef void (*glDrawElementsBaseVertexPROC)(GLenum      mode,
+                                             GLsizei     count,
+                                             GLenum      type,
+                                             const void* indices,
+                                             GLint       basevertex);
+typedef void (*glDrawElementsInstancedBaseVertexPROC)(GLenum      mode,
+                                                      GLsizei     count,
+                                                      GLenum      type,
+                                                      const void* indices,
+                                                      GLsizei     instancecount,
+                                                      GLint       basevertex);
+typedef void (*glMultiDrawElementsIndirectPROC)(GLenum      mode,
+                                                GLenum      type,
+                                                const void* indirect,
+                                                GLsizei     drawcount,
+                                                GLsizei     stride);
+typedef void (*glVertexAttribIPointerPROC)(GLuint      index,
+                                           GLint       size,
+                                           GLenum      type,
+                                           GLsizei     stride,
+                                           const void* pointer);
+typedef void (*glVertexAttribDivisorPROC)(GLuint index, GLuint divisor);
+typedef void (*glBindBufferRangePROC)(GLenum     target,
+                                      GLuint     index,
+                                      GLuint     buffer,
+                                      GLintptr   offset,
+                                      GLsizeiptr size);
+typedef void* (*glMapBufferRangePROC)(GLenum     target,
+                                      GLintptr   offset,
+                                      GLsizeiptr length,
+                                      GLbitfield access);
+typedef GLsync (*glFenceSyncPROC)(GLenum condition, GLbitfield flags);
+typedef GLenum (*glClientWaitSyncPROC)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (*glDeleteSyncPROC)(GLsync sync);
+// GL 4.4 / ARB_buffer_storage; optional, NULL when unsupported
+typedef void (*glBufferStoragePROC)(GLenum      target,
+                                    GLsizeiptr  size,
+                                    const void* data,
+                                    GLbitfield  flags);
+typedef GLuint (*glGetProgramResourceIndexPROC)(GLuint        program,
+                                               GLenum        programInterface,
+                                               const GLchar* name);
+typedef void (*glGetProgramResourceivPROC)(GLuint        program,
+                                           GLenum        programInterface,
+                                           GLuint        index,
+                                           GLsizei       propCount,
+                                           const GLenum* props,
+                                           GLsizei       count,
+                                           GLsizei*      length,
+                                           GLint*        params);
+typedef void (*glGetProgramInterfaceivPROC)(GLuint program,
+                                            GLenum programInterface,
+                                            GLenum pname,
+                                            GLint* params);
+typedef void (*glGetProgramResourceNamePROC)(GLuint   program,
+                                             GLenum   programInterface,
+                                             GLuint   index,
+                                             GLsizei  bufSize,
+                                             GLsizei* length,
+                                             GLchar*  name);
+typedef void (*glGenFramebuffersPROC)(GLsizei n, GLuint* framebuffers);
+typedef void (*glDeleteFramebuffersPROC)(GLsizei n, const GLuint* framebuffers);
+typedef void (*glBindFramebufferPROC)(GLenum target, GLuint framebuffer);
+typedef GLenum (*glCheckFramebufferStatusPROC)(GLenum target);
+typedef void (*glGenRenderbuffersPROC)(GLsizei n, GLuint* renderbuffers);
+typedef void (*glDeleteRenderbuffersPROC)(GLsizei n, const GLuint* renderbuffers);
+typedef void (*glBindRenderbufferPROC)(GLenum target, GLuint renderbuffer);
+typedef void (*glRenderbufferStoragePROC)(GLenum  target,
+                                           GLenum  internalformat,
+                                           GLsizei width,
+                                           GLsizei height);
+typedef void (*glFramebufferRenderbufferPROC)(GLenum target,
+                                               GLenum attachment,
+                                               GLenum renderbuffertarget,
+                                               GLuint renderbuffer);
+typedef void (*glFramebufferTexture2DPROC)(GLenum target,
+                                           GLenum attachment,
+                                           GLenum textarget,
+                                           GLuint texture,
+                                           GLint  level);
+typedef void (*glGetProgramBinaryPROC)(GLuint   program,
+                                       GLsizei  bufSize,
+                                       GLsizei* length,
+                                       GLenum*  binaryFormat,
+                                       void*    binary);
+typedef void (*glProgramBinaryPROC)(GLuint      program,
+                                    GLenum      binaryFormat,
+                                    const void* binary,
+                                    GLsizei     length);
+typedef void (*glProgramParameteriPROC)(GLuint program, GLenum pname, GLint value);
+typedef const GLubyte* (*glGetStringiPROC)(GLenum name, GLuint index);
+// GL_KHR_parallel_shader_compile; optional, NULL when unsupported
+typedef void (*glMaxShaderCompilerThreadsKHRPROC)(GLuint count);
+typedef void (*glDispatchComputePROC)(GLuint num_groups_x,
+                                      GLuint num_groups_y,
+                                      GLuint num_groups_z);
+typedef void (*glDispatchComputeIndirectPROC)(GLintptr indirect);
+typedef void (*glMemoryBarrierPROC)(GLbitfield barriers);
+typedef void (*glBindImageTexturePROC)(GLuint    unit,
+                                       GLuint    texture,
+                                       GLint     level,
+                                       GLboolean layered,
+                                       GLint     layer,
+                                       GLenum    access,
+                                       GLenum    format);
+typedef void (*glClearBufferDataPROC)(GLenum      target,
+                                      GLenum      internalformat,
+                                      GLenum      format,
+                                      GLenum      type,
+                                      const void* data);
+typedef void (*glTexStorage2DPROC)(GLenum  target,
+                                   GLsizei levels,
+                                   GLenum  internalformat,
+                                   GLsizei width,
+                                   GLsizei height);
+// GL 4.6 or GL_ARB_indirect_parameters; optional, NULL when unsupported
+typedef void (*glMultiDrawElementsIndirectCountPROC)(GLenum      mode,
+                                                     GLenum      type,
+                                                     const void* indirect,
+                                                     GLintptr    drawcount,
+                                                     GLsizei     maxdrawcount,
+                                                     GLsizei     stride);
+typedef void (*glBlendFuncSeparatePROC)(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha);
+typedef void (*glBlendEquationSeparatePROC)(GLenum modeRGB, GLenum modeAlpha);
+
+// Loader slots: defined (zero, so NULL until RGL_loadGL3) in the one translation unit that
+// sets RGL_LOAD_IMPLEMENTATION, declared extern everywhere else.
+#ifdef RGL_LOAD_IMPLEMENTATION
+#  define RGL_EXTERN
+#else
+#  define RGL_EXTERN extern
+#endif
 
-glShaderSourcePROC             glShaderSourceSRC             = NULL;
-glCreateShaderPROC             glCreateShaderSRC             = NULL;
-glCompileShaderPROC            glCompileShaderSRC            = NULL;
-glCreateProgramPROC            glCreateProgramSRC            = NULL;
-glAttachShaderPROC             glAttachShaderSRC             = NULL;
-glBindAttribLocationPROC       glBindAttribLocationSRC       = NULL;
-glLinkProgramPROC              glLinkProgramSRC              = NULL;
-glBindBufferPROC               glBindBufferSRC               = NULL;
-glBufferDataPROC               glBufferDataSRC               = NULL;
-glEnableVertexAttribArrayPROC  glEnableVertexAttribArraySRC  = NULL;
-glVertexAttribPointerPROC      glVertexAttribPointerSRC      = NULL;
-glDisableVertexAttribArrayPROC glDisableVertexAttribArraySRC = NULL;
-glDeleteBuffersPROC            glDeleteBuffersSRC            = NULL;
-glDeleteVertexArraysPROC       glDeleteVertexArraysSRC       = NULL;
-glUseProgramPROC               glUseProgramSRC               = NULL;
-glDetachShaderPROC             glDetachShaderSRC             = NULL;
-glDeleteShaderPROC             glDeleteShaderSRC             = NULL;
-glDeleteProgramPROC            glDeleteProgramSRC            = NULL;
-glBufferSubDataPROC            glBufferSubDataSRC            = NULL;
-glGetShaderivPROC              glGetShaderivSRC              = NULL;
-glGetShaderInfoLogPROC         glGetShaderInfoLogSRC         = NULL;
-glGetProgramivPROC             glGetProgramivSRC             = NULL;
-glGetProgramInfoLogPROC        glGetProgramInfoLogSRC        = NULL;
-glGenVertexArraysPROC          glGenVertexArraysSRC          = NULL;
-glGenBuffersPROC               glGenBuffersSRC               = NULL;
-glBindVertexArrayPROC          glBindVertexArraySRC          = NULL;
-glGetUniformLocationPROC       glGetUniformLocationSRC       = NULL;
-glUniformMatrix4fvPROC         glUniformMatrix4fvSRC         = NULL;
-glActiveTexturePROC            glActiveTextureSRC            = NULL;
-glDebugMessageCallbackPROC     glDebugMessageCallbackSRC     = NULL;
-glDrawElementsPROC             glDrawElementsSRC             = NULL;
-glClearPROC                    glClearSRC                    = NULL;
-glClearColorPROC               glClearColorSRC               = NULL;
-glViewportPROC                 glViewportSRC                 = NULL;
+RGL_EXTERN glShaderSourcePROC                    glShaderSourceSRC;
+RGL_EXTERN glCreateShaderPROC                    glCreateShaderSRC;
+RGL_EXTERN glCompileShaderPROC                   glCompileShaderSRC;
+RGL_EXTERN glCreateProgramPROC                   glCreateProgramSRC;
+RGL_EXTERN glAttachShaderPROC                    glAttachShaderSRC;
+RGL_EXTERN glBindAttribLocationPROC              glBindAttribLocationSRC;
+RGL_EXTERN glLinkProgramPROC                     glLinkProgramSRC;
+RGL_EXTERN glBindBufferPROC                      glBindBufferSRC;
+RGL_EXTERN glBufferDataPROC                      glBufferDataSRC;
+RGL_EXTERN glEnableVertexAttribArrayPROC         glEnableVertexAttribArraySRC;
+RGL_EXTERN glVertexAttribPointerPROC             glVertexAttribPointerSRC;
+RGL_EXTERN glDisableVertexAttribArrayPROC        glDisableVertexAttribArraySRC;
+RGL_EXTERN glDeleteBuffersPROC                   glDeleteBuffersSRC;
+RGL_EXTERN glDeleteVertexArraysPROC              glDeleteVertexArraysSRC;
+RGL_EXTERN glUseProgramPROC                      glUseProgramSRC;
+RGL_EXTERN glDetachShaderPROC                    glDetachShaderSRC;
+RGL_EXTERN glDeleteShaderPROC                    glDeleteShaderSRC;
+RGL_EXTERN glDeleteProgramPROC                   glDeleteProgramSRC;
+RGL_EXTERN glBufferSubDataPROC                   glBufferSubDataSRC;
+RGL_EXTERN glGetShaderivPROC                     glGetShaderivSRC;
+RGL_EXTERN glGetShaderInfoLogPROC                glGetShaderInfoLogSRC;
+RGL_EXTERN glGetProgramivPROC                    glGetProgramivSRC;
+RGL_EXTERN glGetProgramInfoLogPROC               glGetProgramInfoLogSRC;
+RGL_EXTERN glGenVertexArraysPROC                 glGenVertexArraysSRC;
+RGL_EXTERN glGenBuffersPROC                      glGenBuffersSRC;
+RGL_EXTERN glBindVertexArrayPROC                 glBindVertexArraySRC;
+RGL_EXTERN glGetUniformLocationPROC              glGetUniformLocationSRC;
+RGL_EXTERN glUniformMatrix4fvPROC                glUniformMatrix4fvSRC;
+RGL_EXTERN glActiveTexturePROC                   glActiveTextureSRC;
+RGL_EXTERN glDebugMessageCallbackPROC            glDebugMessageCallbackSRC;
+RGL_EXTERN glDrawElementsPROC                    glDrawElementsSRC;
+RGL_EXTERN glClearPROC                           glClearSRC;
+RGL_EXTERN glClearColorPROC                      glClearColorSRC;
+RGL_EXTERN glViewportPROC                        glViewportSRC;
 
-glUniform1iPROC  glUniform1iSRC  = NULL;
-glUniform4fvPROC glUniform4fvSRC = NULL;
-glUniform1fPROC  glUniform1fSRC  = NULL;
-glUniform1fvPROC glUniform1fvSRC = NULL;
+RGL_EXTERN glUniform1iPROC                       glUniform1iSRC;
+RGL_EXTERN glUniform4fvPROC                      glUniform4fvSRC;
+RGL_EXTERN glUniform1fPROC                       glUniform1fSRC;
+RGL_EXTERN glUniform1fvPROC                      glUniform1fvSRC;
 
-glObjectLabelPROC    glObjectLabelSRC    = NULL;
-glBindBufferBasePROC glBindBufferBaseSRC = NULL;
+RGL_EXTERN glObjectLabelPROC                     glObjectLabelSRC;
+RGL_EXTERN glBindBufferBasePROC                  glBindBufferBaseSRC;
+RGL_EXTERN glDrawElementsInstancedPROC           glDrawElementsInstancedSRC;
+RGL_EXTERN glDrawElementsBaseVertexPROC          glDrawElementsBaseVertexSRC;
+RGL_EXTERN glDrawElementsInstancedBaseVertexPROC glDrawElementsInstancedBaseVertexSRC;
+RGL_EXTERN glMultiDrawElementsIndirectPROC       glMultiDrawElementsIndirectSRC;
+RGL_EXTERN glVertexAttribIPointerPROC            glVertexAttribIPointerSRC;
+RGL_EXTERN glVertexAttribDivisorPROC             glVertexAttribDivisorSRC;
+RGL_EXTERN glBindBufferRangePROC                 glBindBufferRangeSRC;
+RGL_EXTERN glMapBufferRangePROC                  glMapBufferRangeSRC;
+RGL_EXTERN glFenceSyncPROC                       glFenceSyncSRC;
+RGL_EXTERN glClientWaitSyncPROC                  glClientWaitSyncSRC;
+RGL_EXTERN glDeleteSyncPROC                      glDeleteSyncSRC;
+RGL_EXTERN glBufferStoragePROC                   glBufferStorageSRC;
+RGL_EXTERN glGetProgramResourceIndexPROC         glGetProgramResourceIndexSRC;
+RGL_EXTERN glGetProgramResourceivPROC            glGetProgramResourceivSRC;
+RGL_EXTERN glGetProgramInterfaceivPROC           glGetProgramInterfaceivSRC;
+RGL_EXTERN glGetProgramResourceNamePROC          glGetProgramResourceNameSRC;
+RGL_EXTERN glGenFramebuffersPROC                 glGenFramebuffersSRC;
+RGL_EXTERN glDeleteFramebuffersPROC              glDeleteFramebuffersSRC;
+RGL_EXTERN glBindFramebufferPROC                 glBindFramebufferSRC;
+RGL_EXTERN glCheckFramebufferStatusPROC          glCheckFramebufferStatusSRC;
+RGL_EXTERN glGenRenderbuffersPROC                glGenRenderbuffersSRC;
+RGL_EXTERN glDeleteRenderbuffersPROC             glDeleteRenderbuffersSRC;
+RGL_EXTERN glBindRenderbufferPROC                glBindRenderbufferSRC;
+RGL_EXTERN glRenderbufferStoragePROC             glRenderbufferStorageSRC;
+RGL_EXTERN glFramebufferRenderbufferPROC         glFramebufferRenderbufferSRC;
+RGL_EXTERN glFramebufferTexture2DPROC            glFramebufferTexture2DSRC;
+RGL_EXTERN glGetProgramBinaryPROC                glGetProgramBinarySRC;
+RGL_EXTERN glProgramBinaryPROC                   glProgramBinarySRC;
+RGL_EXTERN glProgramParameteriPROC               glProgramParameteriSRC;
+RGL_EXTERN glGetStringiPROC                      glGetStringiSRC;
+RGL_EXTERN glMaxShaderCompilerThreadsKHRPROC     glMaxShaderCompilerThreadsKHRSRC;
+RGL_EXTERN glDispatchComputePROC                 glDispatchComputeSRC;
+RGL_EXTERN glDispatchComputeIndirectPROC         glDispatchComputeIndirectSRC;
+RGL_EXTERN glMemoryBarrierPROC                   glMemoryBarrierSRC;
+RGL_EXTERN glBindImageTexturePROC                glBindImageTextureSRC;
+RGL_EXTERN glClearBufferDataPROC                 glClearBufferDataSRC;
+RGL_EXTERN glTexStorage2DPROC                    glTexStorage2DSRC;
+RGL_EXTERN glMultiDrawElementsIndirectCountPROC  glMultiDrawElementsIndirectCountSRC;
+RGL_EXTERN glBlendFuncSeparatePROC               glBlendFuncSeparateSRC;
+RGL_EXTERN glBlendEquationSeparatePROC           glBlendEquationSeparateSRC;
 
 #define glActiveTexture glActiveTextureSRC
 #define glShaderSource glShaderSourceSRC
@@ -281,6 +458,46 @@ glBindBufferBasePROC glBindBufferBaseSRC = NULL;
 #define glUniform1fv glUniform1fvSRC
 #define glObjectLabel glObjectLabelSRC
 #define glBindBufferBase glBindBufferBaseSRC
+#define glDrawElementsInstanced glDrawElementsInstancedSRC
+#define glDrawElementsBaseVertex glDrawElementsBaseVertexSRC
+#define glDrawElementsInstancedBaseVertex glDrawElementsInstancedBaseVertexSRC
+#define glMultiDrawElementsIndirect glMultiDrawElementsIndirectSRC
+#define glVertexAttribIPointer glVertexAttribIPointerSRC
+#define glVertexAttribDivisor glVertexAttribDivisorSRC
+#define glBindBufferRange glBindBufferRangeSRC
+#define glMapBufferRange glMapBufferRangeSRC
+#define glFenceSync glFenceSyncSRC
+#define glClientWaitSync glClientWaitSyncSRC
+#define glDeleteSync glDeleteSyncSRC
+#define glBufferStorage glBufferStorageSRC
+#define glGetProgramResourceIndex glGetProgramResourceIndexSRC
+#define glGetProgramResourceiv glGetProgramResourceivSRC
+#define glGetProgramInterfaceiv glGetProgramInterfaceivSRC
+#define glGetProgramResourceName glGetProgramResourceNameSRC
+#define glGenFramebuffers glGenFramebuffersSRC
+#define glDeleteFramebuffers glDeleteFramebuffersSRC
+#define glBindFramebuffer glBindFramebufferSRC
+#define glCheckFramebufferStatus glCheckFramebufferStatusSRC
+#define glGenRenderbuffers glGenRenderbuffersSRC
+#define glDeleteRenderbuffers glDeleteRenderbuffersSRC
+#define glBindRenderbuffer glBindRenderbufferSRC
+#define glRenderbufferStorage glRenderbufferStorageSRC
+#define glFramebufferRenderbuffer glFramebufferRenderbufferSRC
+#define glFramebufferTexture2D glFramebufferTexture2DSRC
+#define glGetProgramBinary glGetProgramBinarySRC
+#define glProgramBinary glProgramBinarySRC
+#define glProgramParameteri glProgramParameteriSRC
+#define glGetStringi glGetStringiSRC
+#define glMaxShaderCompilerThreadsKHR glMaxShaderCompilerThreadsKHRSRC
+#define glDispatchCompute glDispatchComputeSRC
+#define glDispatchComputeIndirect glDispatchComputeIndirectSRC
+#define glMemoryBarrier glMemoryBarrierSRC
+#define glBindImageTexture glBindImageTextureSRC
+#define glClearBufferData glClearBufferDataSRC
+#define glTexStorage2D glTexStorage2DSRC
+#define glMultiDrawElementsIndirectCount glMultiDrawElementsIndirectCountSRC
+#define glBlendFuncSeparate glBlendFuncSeparateSRC
+#define glBlendEquationSeparate glBlendEquationSeparateSRC
 
 extern int RGL_loadGL3(RGLloadfunc proc);
 
@@ -331,6 +548,49 @@ int RGL_loadGL3(RGLloadfunc proc) {
   RGL_PROC_DEF(proc, glUniform1fv);
   RGL_PROC_DEF(proc, glObjectLabel);
   RGL_PROC_DEF(proc, glBindBufferBase);
+  RGL_PROC_DEF(proc, glDrawElementsInstanced);
+  RGL_PROC_DEF(proc, glDrawElementsBaseVertex);
+  RGL_PROC_DEF(proc, glDrawElementsInstancedBaseVertex);
+  RGL_PROC_DEF(proc, glMultiDrawElementsIndirect);
+  RGL_PROC_DEF(proc, glVertexAttribIPointer);
+  RGL_PROC_DEF(proc, glVertexAttribDivisor);
+  RGL_PROC_DEF(proc, glBindBufferRange);
+  RGL_PROC_DEF(proc, glMapBufferRange);
+  RGL_PROC_DEF(proc, glFenceSync);
+  RGL_PROC_DEF(proc, glClientWaitSync);
+  RGL_PROC_DEF(proc, glDeleteSync);
+  RGL_PROC_DEF(proc, glBufferStorage);
+  RGL_PROC_DEF(proc, glGetProgramResourceIndex);
+  RGL_PROC_DEF(proc, glGetProgramResourceiv);
+  RGL_PROC_DEF(proc, glGetProgramInterfaceiv);
+  RGL_PROC_DEF(proc, glGetProgramResourceName);
+  RGL_PROC_DEF(proc, glGenFramebuffers);
+  RGL_PROC_DEF(proc, glDeleteFramebuffers);
+  RGL_PROC_DEF(proc, glBindFramebuffer);
+  RGL_PROC_DEF(proc, glCheckFramebufferStatus);
+  RGL_PROC_DEF(proc, glGenRenderbuffers);
+  RGL_PROC_DEF(proc, glDeleteRenderbuffers);
+  RGL_PROC_DEF(proc, glBindRenderbuffer);
+  RGL_PROC_DEF(proc, glRenderbufferStorage);
+  RGL_PROC_DEF(proc, glFramebufferRenderbuffer);
+  RGL_PROC_DEF(proc, glFramebufferTexture2D);
+  RGL_PROC_DEF(proc, glGetProgramBinary);
+  RGL_PROC_DEF(proc, glProgramBinary);
+  RGL_PROC_DEF(proc, glProgramParameteri);
+  RGL_PROC_DEF(proc, glGetStringi);
+  RGL_PROC_DEF(proc, glMaxShaderCompilerThreadsKHR);
+  RGL_PROC_DEF(proc, glDispatchCompute);
+  RGL_PROC_DEF(proc, glDispatchComputeIndirect);
+  RGL_PROC_DEF(proc, glMemoryBarrier);
+  RGL_PROC_DEF(proc, glBindImageTexture);
+  RGL_PROC_DEF(proc, glClearBufferData);
+  RGL_PROC_DEF(proc, glTexStorage2D);
+  RGL_PROC_DEF(proc, glMultiDrawElementsIndirectCount);
+  if (glMultiDrawElementsIndirectCountSRC == NULL)
+    glMultiDrawElementsIndirectCountSRC =
+        (glMultiDrawElementsIndirectCountPROC)proc("glMultiDrawElementsIndirectCountARB");
+  RGL_PROC_DEF(proc, glBlendFuncSeparate);
+  RGL_PROC_DEF(proc, glBlendEquationSeparate);
 
   if (glShaderSourceSRC == NULL || glCreateShaderSRC == NULL || glCompileShaderSRC == NULL ||
       glCreateProgramSRC == NULL || glAttachShaderSRC == NULL || glBindAttribLocationSRC == NULL ||
@@ -345,7 +605,24 @@ int RGL_loadGL3(RGLloadfunc proc) {
       glUniformMatrix4fvSRC == NULL || glUniform1iSRC == NULL || glUniform4fvSRC == NULL ||
       glUniform1fSRC == NULL || glUniform1fvSRC == NULL || glObjectLabelSRC == NULL ||
       glBindBufferBaseSRC == NULL || glClearSRC == NULL || glClearColorSRC == NULL ||
-      glViewportSRC == NULL)
+      glViewportSRC == NULL || glDrawElementsInstancedSRC == NULL ||
+      glDrawElementsBaseVertexSRC == NULL || glDrawElementsInstancedBaseVertexSRC == NULL ||
+      glMultiDrawElementsIndirectSRC == NULL || glVertexAttribIPointerSRC == NULL ||
+      glVertexAttribDivisorSRC == NULL || glBindBufferRangeSRC == NULL ||
+      glMapBufferRangeSRC == NULL || glFenceSyncSRC == NULL || glClientWaitSyncSRC == NULL ||
+      glDeleteSyncSRC == NULL || glGetProgramResourceIndexSRC == NULL ||
+      glGetProgramResourceivSRC == NULL || glGetProgramInterfaceivSRC == NULL ||
+      glGetProgramResourceNameSRC == NULL || glGenFramebuffersSRC == NULL ||
+      glDeleteFramebuffersSRC == NULL || glBindFramebufferSRC == NULL ||
+      glCheckFramebufferStatusSRC == NULL || glGenRenderbuffersSRC == NULL ||
+      glDeleteRenderbuffersSRC == NULL || glBindRenderbufferSRC == NULL ||
+      glRenderbufferStorageSRC == NULL || glFramebufferRenderbufferSRC == NULL ||
+      glFramebufferTexture2DSRC == NULL || glGetProgramBinarySRC == NULL ||
+      glProgramBinarySRC == NULL || glProgramParameteriSRC == NULL || glGetStringiSRC == NULL ||
+      glDispatchComputeSRC == NULL || glDispatchComputeIndirectSRC == NULL ||
+      glMemoryBarrierSRC == NULL || glBindImageTextureSRC == NULL || glClearBufferDataSRC == NULL ||
+      glTexStorage2DSRC == NULL || glBlendFuncSeparateSRC == NULL ||
+      glBlendEquationSeparateSRC == NULL)
     return 1;
 
   GLuint vao;
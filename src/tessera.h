@@ -0,0 +1,7209 @@
+#ifndef TESSERA_H
+#define TESSERA_H
+
+#include <cstdlib>
+#include <format>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/vec3.hpp>   // glm::vec3
+#include <glm/vec4.hpp>   // glm::vec4
+#include <print>
+#include <unordered_map>
+#include <utility>
+//
+#define LOGF_INFO(fmt, ...)                                                                        \
+  logMessage(LogLevel::Info, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
+#define LOGF_WARN(fmt, ...)                                                                        \
+  logMessage(LogLevel::Warning, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
+
+#define LOGF_ERROR(fmt, ...)                                                                       \
+  logMessage(LogLevel::Error, std::format(fmt, __VA_ARGS__), __FILE__, __LINE__)
+
+#define LOG_INFO(msg) logMessage(LogLevel::Info, msg, __FILE__, __LINE__)
+#define LOG_WARN(msg) logMessage(LogLevel::Warning, msg, __FILE__, __LINE__)
+
+#define LOG_ERROR(msg) logMessage(LogLevel::Error, msg, __FILE__, __LINE__)
+
+enum class LogLevel { Info, Warning, Error };
+
+inline void logMessage(LogLevel level, std::string_view message, const char* file, int line) {
+  const char* levelStr = level == LogLevel::Info      ? "INFO"
+                         : level == LogLevel::Warning ? "WARN"
+                                                      : "ERROR";
+
+  std::println(stderr, "[{}] {} ({}:{})", levelStr, message, file, line);
+}
+
+#ifdef NDEBUG
+
+#  define ASSERT(cond) ((void)0)
+
+#else
+
+#  include <cstdlib>
+
+#  define ASSERT(cond)                                                                             \
+    do {                                                                                           \
+      if (!(cond)) {                                                                               \
+        logMessage(LogLevel::Error, "ASSERT FAILED: " #cond, __FILE__, __LINE__);                  \
+        std::abort();                                                                              \
+      }                                                                                            \
+    } while (0)
+
+#endif
+
+#include <cstdlib>
+
+#define ASSERT_ALWAYS(cond)                                                                        \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      logMessage(LogLevel::Error, "ASSERT_ALWAYS FAILED: " #cond, __FILE__, __LINE__);             \
+      std::abort();                                                                                \
+    }                                                                                              \
+  } while (0)
+
+#define CHECK(cond, fmt, ...)                                                                      \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      LOGF_WARN("CHECK FAILED: {}: " fmt, #cond, ##__VA_ARGS__);                                   \
+    }                                                                                              \
+  } while (0)
+
+
+#ifdef __APPLE__
+#  include <OpenGL/gl.h>
+#else
+#  include <GL/gl.h>
+#endif
+#ifndef __EMSCRIPTEN__
+// Exactly one translation unit defines TESSERA_IMPLEMENTATION before including this header; it
+// owns the GL loader slots and RGL_loadGL3.
+#  ifdef TESSERA_IMPLEMENTATION
+#    define RGL_LOAD_IMPLEMENTATION
+#  endif
+#  include "rglLoad.h"
+#else
+#  include <GLES3/gl3.h>
+#endif
+
+inline void APIENTRY glDebugCallback(GLenum        source,
+                                     GLenum        type,
+                                     GLuint        id,
+                                     GLenum        severity,
+                                     GLsizei       length,
+                                     const GLchar* message,
+                                     const void*   userParam) {
+  std::string_view src = source == GL_DEBUG_SOURCE_API               ? "API"
+                         : source == GL_DEBUG_SOURCE_SHADER_COMPILER ? "SHADER"
+                         : source == GL_DEBUG_SOURCE_WINDOW_SYSTEM   ? "WINDOW"
+                         : source == GL_DEBUG_SOURCE_THIRD_PARTY     ? "3RD PARTY"
+                         : source == GL_DEBUG_SOURCE_APPLICATION     ? "APP"
+                                                                     : "OTHER";
+
+  std::string_view msg(message);
+
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+      // Something is seriously wrong — UB or crash likely
+      logMessage(LogLevel::Error,
+                 std::string("GL HIGH : ") + std::string(src) + " : " + std::string(msg),
+                 __FILE__,
+                 __LINE__);
+      // std::abort();
+
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      logMessage(LogLevel::Error,
+                 std::string("GL MEDIUM : ") + std::string(src) + " : " + std::string(msg),
+                 __FILE__,
+                 __LINE__);
+      break;
+
+    case GL_DEBUG_SEVERITY_LOW:
+      logMessage(LogLevel::Warning,
+                 std::string("GL LOW : ") + std::string(src) + " : " + std::string(msg),
+                 __FILE__,
+                 __LINE__);
+      break;
+
+    case GL_DEBUG_SEVERITY_NOTIFICATION:
+      // Optional — often spammy
+      logMessage(LogLevel::Info, msg, __FILE__, __LINE__);
+      break;
+  }
+}
+inline void enableOpenGLDebug() {
+  glEnable(GL_DEBUG_OUTPUT);
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+  glDebugMessageCallback(glDebugCallback, nullptr);
+
+  //  filter out notifications
+  // glDebugMessageControl(GL_DONT_CARE,  GL_DONT_CARE,
+  //                       GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr,
+  //                       GL_FALSE);
+}
+
+#define MULTILINE_STR(...) #__VA_ARGS__
+#define GLSL(code) R"GLSL(code)GLSL"
+#define CONCAT_IMPL(x, y) x##y
+#define CONCAT(x, y) CONCAT_IMPL(x, y)
+
+#define defer(code) auto CONCAT(_defer_, __LINE__) = ScopeExit([&]() { code; })
+template <typename F>
+struct ScopeExit {
+  F f;
+  ScopeExit(F&& f) : f(std::forward<F>(f)) {}
+  ~ScopeExit() { f(); }
+};
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdbool.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// ---- GL state cache ----
+// Shadow copy of the binding and fixed-function state every wrapper goes through. Calls that
+// would not change the bound object are dropped and counted. Anything that touches GL behind its
+// back (imgui, a foreign library) must call invalidate() afterwards.
+enum class GLBind : uint8_t {
+  Program,
+  Pipeline, // render state of a PipelineState, see bindRenderState
+  VertexArray,
+  Buffer,
+  BufferBase,
+  ActiveTexture,
+  Texture,
+  Count
+};
+
+struct GLBindCounter {
+  uint32_t issued = 0; // forwarded to the driver
+  uint32_t elided = 0; // dropped as redundant
+};
+
+struct GLStateStats {
+  std::array<GLBindCounter, size_t(GLBind::Count)> counters{};
+
+  uint64_t uploadedBytes      = 0; // buffer contents written by the wrappers, mapped or not
+  uint32_t barriers           = 0; // glMemoryBarrier calls
+  uint32_t renderStateChanges = 0; // fixed-function fields written by bindRenderState and clear
+
+  GLBindCounter&       operator[](GLBind b) { return counters[size_t(b)]; }
+  const GLBindCounter& operator[](GLBind b) const { return counters[size_t(b)]; }
+
+  uint32_t issued() const {
+    uint32_t n = 0;
+    for (const auto& c : counters)
+      n += c.issued;
+    return n;
+  }
+  uint32_t elided() const {
+    uint32_t n = 0;
+    for (const auto& c : counters)
+      n += c.elided;
+    return n;
+  }
+};
+
+// Fixed-function state a draw depends on. The defaults describe an opaque pass: depth tested
+// and written, no blending, stencil or face culling.
+struct DepthState {
+  bool   test  = true;
+  bool   write = true;
+  GLenum func  = GL_LESS;
+
+  bool operator==(const DepthState&) const = default;
+};
+
+struct BlendState {
+  bool    enable    = false;
+  GLenum  srcColor  = GL_ONE;
+  GLenum  dstColor  = GL_ZERO;
+  GLenum  srcAlpha  = GL_ONE;
+  GLenum  dstAlpha  = GL_ZERO;
+  GLenum  colorOp   = GL_FUNC_ADD;
+  GLenum  alphaOp   = GL_FUNC_ADD;
+  uint8_t colorMask = 0xF; // bit 0 red ... bit 3 alpha
+
+  bool operator==(const BlendState&) const = default;
+};
+
+struct StencilState {
+  bool   enable    = false;
+  GLenum func      = GL_ALWAYS;
+  GLint  ref       = 0;
+  GLuint readMask  = ~GLuint{0};
+  GLuint writeMask = ~GLuint{0};
+  GLenum fail      = GL_KEEP; // stencil test failed
+  GLenum depthFail = GL_KEEP; // stencil passed, depth failed
+  GLenum pass      = GL_KEEP;
+
+  bool operator==(const StencilState&) const = default;
+};
+
+struct RasterState {
+  GLenum cullFace     = GL_NONE; // GL_BACK, GL_FRONT or GL_FRONT_AND_BACK culls
+  GLenum frontFace    = GL_CCW;
+  GLenum polygonMode  = GL_FILL;
+  float  offsetFactor = 0.0f; // glPolygonOffset; both 0 leaves the offset disabled
+  float  offsetUnits  = 0.0f;
+
+  bool operator==(const RasterState&) const = default;
+};
+
+struct RenderState {
+  DepthState   depth;
+  BlendState   blend;
+  StencilState stencil;
+  RasterState  raster;
+
+  bool operator==(const RenderState&) const = default;
+};
+
+struct GLState {
+  static constexpr GLuint kUnknown         = ~GLuint{0};
+  static constexpr size_t kBufferTargets   = 8;
+  static constexpr size_t kIndexedBindings = 32; // per indexed target, higher indices pass through
+  static constexpr size_t kTextureUnits    = 32;
+
+  struct TextureSlot {
+    GLenum target  = 0;
+    GLuint texture = kUnknown;
+  };
+
+  // size 0 means the whole buffer (glBindBufferBase)
+  struct IndexedSlot {
+    GLuint     buffer = kUnknown;
+    GLintptr   offset = 0;
+    GLsizeiptr size   = 0;
+
+    bool operator==(const IndexedSlot&) const = default;
+  };
+
+  GLuint program     = kUnknown;
+  GLuint vertexArray = kUnknown;
+  GLuint activeUnit  = kUnknown;
+  GLuint pipeline    = kUnknown; // id of the PipelineState whose render state is applied
+
+  RenderState renderState;              // what GL has, once renderStateKnown
+  bool        renderStateKnown = false; // false: the next bindRenderState writes every field
+
+  std::array<GLuint, kBufferTargets>                       buffers;
+  std::array<std::array<IndexedSlot, kIndexedBindings>, 2> indexed; // uniform, shader storage
+  std::array<TextureSlot, kTextureUnits>                   textures;
+
+  // The last shader write (SSBO store, image store, atomic) to an object, kept until the object
+  // is deleted. `object` is a buffer for GL_BUFFER, a texture for GL_TEXTURE.
+  struct PendingWrite {
+    GLenum     kind;
+    GLuint     object;
+    GLbitfield visible; // barrier bits issued since the write
+  };
+
+  std::vector<PendingWrite> pendingWrites;
+  GLbitfield                barrierBits = 0; // requested by consume(), issued by flushBarriers()
+
+  GLStateStats stats;
+
+  GLState() { invalidate(); }
+
+  // Forget everything; the next bind of each kind always reaches the driver.
+  void invalidate() {
+    program          = kUnknown;
+    vertexArray      = kUnknown;
+    activeUnit       = kUnknown;
+    pipeline         = kUnknown;
+    renderStateKnown = false;
+    buffers.fill(kUnknown);
+    for (auto& slots : indexed)
+      slots.fill({});
+    textures.fill({});
+  }
+
+  void resetStats() { stats = {}; }
+  void countUpload(size_t bytes) { stats.uploadedBytes += bytes; }
+
+  void useProgram(GLuint id) {
+    if (!changed(program, id, GLBind::Program))
+      return;
+    glUseProgram(id);
+  }
+
+  void bindVertexArray(GLuint id) {
+    if (!changed(vertexArray, id, GLBind::VertexArray))
+      return;
+    glBindVertexArray(id);
+    // the element array binding is VAO state
+    buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+  }
+
+  void bindBuffer(GLenum target, GLuint id) {
+    size_t slot = bufferSlot(target);
+    if (slot < kBufferTargets && !changed(buffers[slot], id, GLBind::Buffer))
+      return;
+    if (slot >= kBufferTargets)
+      ++stats[GLBind::Buffer].issued;
+    glBindBuffer(target, id);
+  }
+
+  void bindBufferBase(GLenum target, GLuint index, GLuint id) {
+    if (!indexedChanged(target, index, {id, 0, 0}))
+      return;
+    glBindBufferBase(target, index, id);
+    // binding an index also replaces the generic binding of the target
+    if (size_t generic = bufferSlot(target); generic < kBufferTargets)
+      buffers[generic] = id;
+  }
+
+  void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) {
+    if (!indexedChanged(target, index, {id, offset, size}))
+      return;
+    glBindBufferRange(target, index, id, offset, size);
+    if (size_t generic = bufferSlot(target); generic < kBufferTargets)
+      buffers[generic] = id;
+  }
+
+  void activeTexture(GLuint unit) {
+    if (!changed(activeUnit, unit, GLBind::ActiveTexture))
+      return;
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+
+  void bindTexture(GLuint unit, GLenum target, GLuint id) {
+    if (unit < kTextureUnits && textures[unit].target == target && textures[unit].texture == id) {
+      ++stats[GLBind::Texture].elided;
+      return;
+    }
+    activeTexture(unit);
+    glBindTexture(target, id);
+    ++stats[GLBind::Texture].issued;
+    if (unit < kTextureUnits)
+      textures[unit] = {target, id};
+  }
+
+  // ---- render state ----
+  // Applies the fixed-function state of PipelineState `id`. Nothing is issued while that pipeline
+  // is still applied; otherwise only the fields that differ from the shadow copy reach GL.
+  void bindRenderState(GLuint id, const RenderState& next) {
+    if (pipeline == id) {
+      ++stats[GLBind::Pipeline].elided;
+      return;
+    }
+    pipeline = id;
+    ++stats[GLBind::Pipeline].issued;
+
+    const bool   known  = renderStateKnown;
+    RenderState& shadow = renderState;
+    renderStateKnown    = true;
+    auto update         = [&](auto&& current, const auto& value) {
+      if (known && current == value)
+        return false;
+      current = value;
+      ++stats.renderStateChanges;
+      return true;
+    };
+
+    const DepthState& depth = next.depth;
+    if (update(shadow.depth.test, depth.test))
+      enable(GL_DEPTH_TEST, depth.test);
+    if (update(shadow.depth.write, depth.write))
+      glDepthMask(depth.write);
+    if (update(shadow.depth.func, depth.func))
+      glDepthFunc(depth.func);
+
+    // functions of a disabled test have no effect and are left as they are once known
+    const BlendState& blend    = next.blend;
+    const bool        blending = blend.enable || !known;
+    if (update(shadow.blend.enable, blend.enable))
+      enable(GL_BLEND, blend.enable);
+    if (blending && update(std::tie(shadow.blend.srcColor,
+                                    shadow.blend.dstColor,
+                                    shadow.blend.srcAlpha,
+                                    shadow.blend.dstAlpha),
+                           std::tie(blend.srcColor,
+                                    blend.dstColor,
+                                    blend.srcAlpha,
+                                    blend.dstAlpha)))
+      glBlendFuncSeparate(blend.srcColor, blend.dstColor, blend.srcAlpha, blend.dstAlpha);
+    if (blending && update(std::tie(shadow.blend.colorOp, shadow.blend.alphaOp),
+                           std::tie(blend.colorOp, blend.alphaOp)))
+      glBlendEquationSeparate(blend.colorOp, blend.alphaOp);
+    if (update(shadow.blend.colorMask, blend.colorMask))
+      setColorMask(blend.colorMask);
+
+    const StencilState& stencil  = next.stencil;
+    const bool          stencils = stencil.enable || !known;
+    if (update(shadow.stencil.enable, stencil.enable))
+      enable(GL_STENCIL_TEST, stencil.enable);
+    if (stencils &&
+        update(std::tie(shadow.stencil.func, shadow.stencil.ref, shadow.stencil.readMask),
+               std::tie(stencil.func, stencil.ref, stencil.readMask)))
+      glStencilFunc(stencil.func, stencil.ref, stencil.readMask);
+    if (stencils &&
+        update(std::tie(shadow.stencil.fail, shadow.stencil.depthFail, shadow.stencil.pass),
+               std::tie(stencil.fail, stencil.depthFail, stencil.pass)))
+      glStencilOp(stencil.fail, stencil.depthFail, stencil.pass);
+    if (update(shadow.stencil.writeMask, stencil.writeMask))
+      glStencilMask(stencil.writeMask);
+
+    const RasterState& raster = next.raster;
+    if (update(shadow.raster.cullFace, raster.cullFace)) {
+      enable(GL_CULL_FACE, raster.cullFace != GL_NONE);
+      if (raster.cullFace != GL_NONE)
+        glCullFace(raster.cullFace);
+    }
+    if (update(shadow.raster.frontFace, raster.frontFace))
+      glFrontFace(raster.frontFace);
+    if (update(shadow.raster.polygonMode, raster.polygonMode))
+      glPolygonMode(GL_FRONT_AND_BACK, raster.polygonMode);
+    if (update(std::tie(shadow.raster.offsetFactor, shadow.raster.offsetUnits),
+               std::tie(raster.offsetFactor, raster.offsetUnits))) {
+      const bool offset = raster.offsetFactor != 0.0f || raster.offsetUnits != 0.0f;
+      enable(GL_POLYGON_OFFSET_FILL, offset);
+      if (offset)
+        glPolygonOffset(raster.offsetFactor, raster.offsetUnits);
+    }
+  }
+
+  // glClear honours the depth, color and stencil write masks, so a pass that ended on a pipeline
+  // without depth writes would leave the depth buffer uncleared. Opens the masks `mask` needs;
+  // the next pipeline bind diffs them back.
+  void clear(GLbitfield mask) {
+    const bool known = renderStateKnown;
+    if ((mask & GL_DEPTH_BUFFER_BIT) && !(known && renderState.depth.write)) {
+      glDepthMask(GL_TRUE);
+      renderState.depth.write = true;
+      pipeline                = kUnknown;
+      ++stats.renderStateChanges;
+    }
+    if ((mask & GL_COLOR_BUFFER_BIT) && !(known && renderState.blend.colorMask == 0xF)) {
+      setColorMask(0xF);
+      renderState.blend.colorMask = 0xF;
+      pipeline                    = kUnknown;
+      ++stats.renderStateChanges;
+    }
+    if ((mask & GL_STENCIL_BUFFER_BIT) && !(known && renderState.stencil.writeMask == ~0u)) {
+      glStencilMask(~GLuint{0});
+      renderState.stencil.writeMask = ~GLuint{0};
+      pipeline                      = kUnknown;
+      ++stats.renderStateChanges;
+    }
+    glClear(mask);
+  }
+
+  // ---- memory barriers ----
+  // Incoherent shader writes only become visible to a later read after glMemoryBarrier with the
+  // bit for that kind of read (GL_SHADER_STORAGE_BARRIER_BIT for SSBO loads,
+  // GL_COMMAND_BARRIER_BIT for indirect commands, ...). Writers report each dispatch or draw
+  // with shaderWrote(). Readers call consume() for every resource they touch and flushBarriers()
+  // before issuing, so a barrier is only emitted for resources that actually have an unseen write,
+  // and only with the bits of the reads that follow.
+  void shaderWrote(GLenum kind, GLuint object) {
+    for (PendingWrite& w : pendingWrites)
+      if (w.kind == kind && w.object == object) {
+        w.visible = 0;
+        return;
+      }
+    pendingWrites.push_back({kind, object, 0});
+  }
+
+  void consume(GLenum kind, GLuint object, GLbitfield access) {
+    for (const PendingWrite& w : pendingWrites)
+      if (w.kind == kind && w.object == object) {
+        barrierBits |= access & ~w.visible;
+        return;
+      }
+  }
+
+  void flushBarriers() {
+    if (!barrierBits)
+      return;
+    glMemoryBarrier(barrierBits);
+    ++stats.barriers;
+
+    // entries stay until the object is forgotten: a later read may need a bit not issued yet
+    for (PendingWrite& w : pendingWrites)
+      w.visible |= barrierBits;
+    barrierBits = 0;
+  }
+
+  // Deleting a bound object reverts its bindings to 0; keep the shadow copy in step.
+  void forgetProgram(GLuint id) {
+    if (program == id)
+      program = 0;
+  }
+
+  void forgetVertexArray(GLuint id) {
+    if (vertexArray == id) {
+      vertexArray                                  = 0;
+      buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+    }
+  }
+
+  void forgetBuffer(GLuint id) {
+    std::erase_if(pendingWrites,
+                  [id](const PendingWrite& w) { return w.kind == GL_BUFFER && w.object == id; });
+    for (GLuint& b : buffers)
+      if (b == id)
+        b = 0;
+    for (auto& slots : indexed)
+      for (IndexedSlot& b : slots)
+        if (b.buffer == id)
+          b = {0, 0, 0};
+  }
+
+  void forgetTexture(GLuint id) {
+    std::erase_if(pendingWrites,
+                  [id](const PendingWrite& w) { return w.kind == GL_TEXTURE && w.object == id; });
+    for (TextureSlot& t : textures)
+      if (t.texture == id)
+        t.texture = 0;
+  }
+
+private:
+  static void enable(GLenum cap, bool on) {
+    if (on)
+      glEnable(cap);
+    else
+      glDisable(cap);
+  }
+
+  static void setColorMask(uint8_t mask) {
+    glColorMask(mask & 1, (mask >> 1) & 1, (mask >> 2) & 1, (mask >> 3) & 1);
+  }
+
+  bool changed(GLuint& cached, GLuint value, GLBind kind) {
+    if (cached == value) {
+      ++stats[kind].elided;
+      return false;
+    }
+    cached = value;
+    ++stats[kind].issued;
+    return true;
+  }
+
+  bool indexedChanged(GLenum target, GLuint index, IndexedSlot value) {
+    size_t slot = indexedSlot(target);
+    if (slot >= indexed.size() || index >= kIndexedBindings) {
+      ++stats[GLBind::BufferBase].issued;
+      return true;
+    }
+    if (indexed[slot][index] == value) {
+      ++stats[GLBind::BufferBase].elided;
+      return false;
+    }
+    indexed[slot][index] = value;
+    ++stats[GLBind::BufferBase].issued;
+    return true;
+  }
+
+  static constexpr size_t bufferSlot(GLenum target) {
+    switch (target) {
+      case GL_ARRAY_BUFFER:
+        return 0;
+      case GL_ELEMENT_ARRAY_BUFFER:
+        return 1;
+      case GL_UNIFORM_BUFFER:
+        return 2;
+      case GL_SHADER_STORAGE_BUFFER:
+        return 3;
+      case GL_DRAW_INDIRECT_BUFFER:
+        return 4;
+      case GL_DISPATCH_INDIRECT_BUFFER:
+        return 5;
+      case GL_COPY_READ_BUFFER:
+        return 6;
+      case GL_COPY_WRITE_BUFFER:
+        return 7;
+      default:
+        return kBufferTargets;
+    }
+  }
+
+  static constexpr size_t indexedSlot(GLenum target) {
+    switch (target) {
+      case GL_UNIFORM_BUFFER:
+        return 0;
+      case GL_SHADER_STORAGE_BUFFER:
+        return 1;
+      default:
+        return 2;
+    }
+  }
+};
+
+inline GLState gGLState;
+
+enum class ShaderStage { Vertex, Fragment, Geometry, Compute, TessControl, TessEval };
+
+struct FileSource {
+  std::string path;
+};
+
+struct StringSource {
+  std::string code;
+};
+
+struct EmbeddedSource {
+  const char* code;
+};
+
+// Read-only view of a whole file, mmap'd where available.
+struct MappedFile {
+  const std::byte*       data = nullptr;
+  size_t                 size = 0;
+  std::vector<std::byte> contents; // fallback storage when mapping is unavailable
+
+  MappedFile() = default;
+
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() { close(); }
+
+  bool open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    defer(::close(fd));
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0)
+      return false;
+
+    void* view = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+      return false;
+    data = static_cast<const std::byte*>(view);
+    size = size_t(st.st_size);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+      return false;
+    contents.assign(std::istreambuf_iterator<char>(file), {});
+    data = contents.data();
+    size = contents.size();
+#endif
+    return size > 0;
+  }
+
+  void close() {
+#ifndef _WIN32
+    if (data)
+      ::munmap(const_cast<std::byte*>(data), size);
+#endif
+    contents.clear();
+    data = nullptr;
+    size = 0;
+  }
+};
+
+struct VertexAttribute {
+  GLuint    location;
+  GLint     size;
+  GLenum    type;
+  GLboolean normalized;
+  GLsizei   stride;
+  size_t    offset;
+};
+
+inline size_t componentSize(GLenum type) {
+  switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      return 2;
+    case GL_DOUBLE:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+// Bytes per vertex of an interleaved stream; a lone attribute may leave its stride at 0.
+inline size_t vertexStride(std::span<const VertexAttribute> attributes) {
+  if (attributes.empty())
+    return 0;
+  if (attributes.front().stride)
+    return attributes.front().stride;
+  ASSERT_ALWAYS(attributes.size() == 1 && "interleaved attributes need an explicit stride");
+  return attributes.front().size * componentSize(attributes.front().type);
+}
+
+struct BufferData {
+  GLenum                     target;
+  std::span<const std::byte> bytes;
+};
+
+// One vertex buffer and at most one index buffer (of indexType). The bytes are borrowed and must
+// stay alive until the mesh is built.
+struct MeshSpec {
+  std::vector<BufferData>      buffers;
+  std::vector<VertexAttribute> attributes;
+  GLsizei                      indexCount = 0;
+  GLenum                       indexType  = GL_UNSIGNED_INT; // or GL_UNSIGNED_SHORT
+};
+
+// Object-space extent of a mesh: an AABB and the sphere around its center. A negative radius
+// means unknown; such meshes are never culled.
+struct Bounds {
+  glm::vec3 min{0.0f};
+  glm::vec3 max{0.0f};
+  glm::vec3 center{0.0f};
+  float     radius = -1.0f;
+
+  bool valid() const { return radius >= 0.0f; }
+};
+
+// Maps stored positions back to object space: object = stored * scale + offset. Quantized meshes
+// carry one and Renderable::model folds it into the model matrix. VertexEncoder scales every axis
+// alike, so the folded matrix stays a similarity of the object's own and normals transformed by
+// mat3(model) keep their directions.
+struct PositionDecode {
+  glm::vec3 scale{1.0f};
+  glm::vec3 offset{0.0f};
+
+  bool identity() const { return scale == glm::vec3(1.0f) && offset == glm::vec3(0.0f); }
+
+  // model * translate(offset) * scale(scale)
+  glm::mat4 apply(const glm::mat4& model) const {
+    if (identity())
+      return model;
+    glm::mat4 m = model;
+    m[3]        = model * glm::vec4(offset, 1.0f);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    return m;
+  }
+};
+
+// A cluster of a mesh's triangles: indices [firstIndex, firstIndex + indexCount) of the mesh. The
+// sphere bounds its vertices and the cone holds the axis and cutoff of its triangle normals, both
+// in object space; a cutoff of 1 means the triangles never all face away at once. See
+// MeshletBuilder.
+struct Meshlet {
+  glm::vec4 sphere{0.0f};
+  glm::vec4 cone{0.0f, 0.0f, 1.0f, 1.0f};
+  uint32_t  firstIndex = 0; // relative to the mesh's first index
+  uint32_t  indexCount = 0;
+};
+
+// One level of detail: indices [firstIndex, firstIndex + indexCount) of the mesh over its shared
+// vertices, and the level's object-space geometric error, how far its surface strays from the
+// full mesh. Level 0 is the full mesh itself. See MeshSimplifier.
+struct MeshLod {
+  uint32_t firstIndex = 0; // relative to the mesh's first index
+  uint32_t indexCount = 0;
+  float    error      = 0.0f;
+};
+
+// Non-owning view of a mesh's vertex and index streams, e.g. inside a mapped .tmesh file.
+// buildMesh and GeometryHeap::add upload straight from it. The index stream holds indexCount
+// indices of the full mesh, followed by those of any coarser levels of detail.
+struct MeshView {
+  std::span<const std::byte>       vertices;
+  std::span<const std::byte>       indices; // of indexType
+  std::span<const VertexAttribute> attributes;
+  GLsizei                          indexCount = 0;
+  GLenum                           indexType  = GL_UNSIGNED_INT;
+  Bounds                           bounds; // computed from the vertices when not valid()
+  PositionDecode                   decode; // identity unless the positions are quantized
+  std::span<const Meshlet>         meshlets; // optional, copied into the Mesh
+  std::span<const MeshLod>         lods;     // optional, copied into the Mesh
+};
+
+// Bump storage for mesh streams that are generated rather than loaded, so MeshSpecs have
+// something to borrow until upload. Blocks never move: spans stay valid until reset().
+struct MeshArena {
+  static constexpr size_t kBlockSize = size_t{4} << 20;
+
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t                       size = 0;
+    size_t                       used = 0;
+  };
+  std::vector<Block> blocks;
+
+  // Uninitialized storage for `count` Ts; fill it in place rather than copying into it.
+  template <typename T>
+  std::span<T> allocate(size_t count) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= alignof(std::max_align_t));
+    const size_t bytes  = count * sizeof(T);
+    Block*       block  = blocks.empty() ? nullptr : &blocks.back();
+    size_t       offset = block ? (block->used + alignof(T) - 1) & ~(alignof(T) - 1) : 0;
+    if (!block || offset + bytes > block->size) {
+      const size_t size = std::max(bytes, kBlockSize);
+      block  = &blocks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(size), size);
+      offset = 0;
+    }
+    block->used = offset + bytes;
+    return {reinterpret_cast<T*>(block->data.get() + offset), count};
+  }
+
+  void reset() { blocks.clear(); }
+};
+
+inline MeshView viewOf(const MeshSpec& spec) {
+  MeshView view{
+      .attributes = spec.attributes, .indexCount = spec.indexCount, .indexType = spec.indexType};
+  for (const BufferData& buf : spec.buffers) {
+    auto& stream = buf.target == GL_ELEMENT_ARRAY_BUFFER ? view.indices : view.vertices;
+    ASSERT_ALWAYS(stream.empty() && "MeshSpec holds one vertex and one index buffer");
+    stream = buf.bytes;
+  }
+  return view;
+}
+
+// Bounds of the float position attribute at location 0 in the view's vertex stream.
+inline Bounds computeBounds(const MeshView& mesh) {
+  auto position = std::ranges::find(mesh.attributes, GLuint{0}, &VertexAttribute::location);
+  if (position == mesh.attributes.end() || position->type != GL_FLOAT || position->size < 3)
+    return {};
+
+  const std::span<const std::byte> bytes  = mesh.vertices;
+  const size_t                     stride = position->stride ? position->stride : 3 * sizeof(float);
+  if (bytes.size() < position->offset + 3 * sizeof(float))
+    return {};
+  const size_t count = (bytes.size() - position->offset - 3 * sizeof(float)) / stride + 1;
+
+  auto read = [&](size_t i) {
+    glm::vec3 p;
+    std::memcpy(&p, bytes.data() + position->offset + i * stride, sizeof(p));
+    return p;
+  };
+
+  Bounds bounds;
+  bounds.min = bounds.max = read(0);
+  for (size_t i = 1; i < count; ++i) {
+    glm::vec3 p = read(i);
+    bounds.min  = glm::min(bounds.min, p);
+    bounds.max  = glm::max(bounds.max, p);
+  }
+
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  float radius2 = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 d = read(i) - bounds.center;
+    radius2     = std::max(radius2, glm::dot(d, d));
+  }
+  bounds.radius = std::sqrt(radius2);
+  return bounds;
+}
+
+inline Bounds computeBounds(const MeshSpec& spec) { return computeBounds(viewOf(spec)); }
+
+struct Mesh {
+  GLuint  vao        = 0;
+  GLuint  vbo        = 0;
+  GLuint  ebo        = 0;
+  GLsizei indexCount = 0;
+  GLenum  indexType  = GL_UNSIGNED_INT;
+
+  // Meshes sub-allocated from a GeometryHeap share its VAO and buffers and own none of them.
+  uint32_t             heapId     = 0; // GeometryHeap::id, 0 outside a heap
+  GLint                baseVertex = 0;
+  GLuint               firstIndex = 0;
+  uint32_t             sortId     = 0; // mesh field of the draw sort key
+  Bounds               bounds;         // object space, also for quantized positions
+  PositionDecode       decode;
+  std::vector<Meshlet> meshlets; // object space, drawn per cluster by RenderPass::clusterCulling
+  std::vector<MeshLod> lods;     // lods[0] is the full mesh; empty without levels of detail
+
+  Mesh() = default;
+
+  Mesh(const Mesh&)            = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
+  Mesh(Mesh&& other) noexcept { *this = std::move(other); }
+
+  Mesh& operator=(Mesh&& other) noexcept {
+    destroy();
+    vao        = other.vao;
+    vbo        = other.vbo;
+    ebo        = other.ebo;
+    indexCount = other.indexCount;
+    indexType  = other.indexType;
+    heapId     = other.heapId;
+    baseVertex = other.baseVertex;
+    firstIndex = other.firstIndex;
+    sortId     = other.sortId;
+    bounds     = other.bounds;
+    decode     = other.decode;
+    meshlets   = std::move(other.meshlets);
+    lods       = std::move(other.lods);
+
+    other.vao = other.vbo = other.ebo = 0;
+    other.indexCount                  = 0;
+    other.heapId                      = 0;
+    return *this;
+  }
+
+  // Index range of level of detail `lod`; level 0 is the full mesh, with or without levels.
+  GLsizei lodIndexCount(uint32_t lod) const {
+    return lod ? static_cast<GLsizei>(lods[lod].indexCount) : indexCount;
+  }
+  GLuint lodFirstIndex(uint32_t lod) const { return firstIndex + (lod ? lods[lod].firstIndex : 0); }
+
+  const void* indexOffset(uint32_t lod = 0) const {
+    return reinterpret_cast<const void*>(uintptr_t{lodFirstIndex(lod)} * componentSize(indexType));
+  }
+
+  void draw() const {
+    ASSERT_ALWAYS(vao != 0);
+    gGLState.bindVertexArray(vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, indexOffset(), baseVertex);
+  }
+
+  void drawInstanced(GLsizei instances, uint32_t lod = 0) const {
+    ASSERT_ALWAYS(vao != 0);
+    gGLState.bindVertexArray(vao);
+    glDrawElementsInstancedBaseVertex(
+        GL_TRIANGLES, lodIndexCount(lod), indexType, indexOffset(lod), instances, baseVertex);
+  }
+
+  void setDebugName(const char* name) {
+    glObjectLabel(GL_VERTEX_ARRAY, vao, -1, name);
+    if (vbo)
+      glObjectLabel(GL_BUFFER, vbo, -1, "VBO");
+    if (ebo)
+      glObjectLabel(GL_BUFFER, ebo, -1, "EBO");
+  }
+  ~Mesh() { destroy(); }
+
+  void destroy() {
+    if (heapId) {
+      // storage belongs to the heap
+      heapId = 0;
+      vao = vbo = ebo = 0;
+    }
+    if (vao) {
+      glDeleteVertexArrays(1, &vao);
+      gGLState.forgetVertexArray(vao);
+    }
+    if (vbo) {
+      glDeleteBuffers(1, &vbo);
+      gGLState.forgetBuffer(vbo);
+    }
+    if (ebo) {
+      glDeleteBuffers(1, &ebo);
+      gGLState.forgetBuffer(ebo);
+    }
+
+    vao = vbo = ebo = 0;
+    indexCount      = 0;
+  }
+};
+// ---- uniform ids ----
+// Uniform and block names are identified by their 32-bit FNV-1a hash. "u_Model"_uid hashes at
+// compile time, so hot-path setters neither allocate nor hash strings.
+constexpr uint32_t fnv1a(std::string_view s) {
+  uint32_t h = 2166136261u;
+  for (char c : s) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// 64-bit variant for content keys; pass the previous result as `h` to hash several pieces.
+constexpr uint64_t fnv1a64(std::string_view s, uint64_t h = 14695981039346656037ull) {
+  for (char c : s) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+struct UniformId {
+  uint32_t value = 0;
+
+  static constexpr UniformId of(std::string_view name) { return {fnv1a(name)}; }
+  constexpr bool             operator==(const UniformId&) const = default;
+};
+
+consteval UniformId operator""_uid(const char* name, size_t length) {
+  return UniformId::of({name, length});
+}
+
+// Active uniform reflected at link time. Arrays are keyed without their "[0]" suffix.
+struct UniformInfo {
+  uint32_t    id;
+  GLint       location;   // -1 for block members
+  GLenum      type;
+  GLint       arraySize;
+  GLint       blockIndex; // GL_UNIFORM_BLOCK index, -1 in the default block
+  GLint       offset;     // byte offset inside the block
+  std::string name;
+};
+
+// Active uniform or shader storage block.
+struct BlockInfo {
+  uint32_t    id;
+  GLenum      interface; // GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+  GLuint      index;
+  GLint       binding;
+  GLint       dataSize;
+  std::string name;
+};
+
+// Link state of a Program. Programs from ProgramPipe::buildAsync start out Pending.
+enum class LinkStatus : uint8_t { Ready, Pending, Failed };
+
+struct ProgramCache;
+
+// Shaders and cache slot of a program whose link was submitted but not yet checked.
+struct PendingLink {
+  std::vector<GLuint> shaders;
+  ProgramCache*       cache = nullptr;
+  uint64_t            key   = 0;
+};
+
+struct Program {
+  GLuint id = 0;
+
+  LinkStatus                   status = LinkStatus::Ready;
+  std::unique_ptr<PendingLink> pending;
+  uint32_t                     generation = 0; // bumped by replace(); see Material::ready
+
+  Program() = default;
+  explicit Program(GLuint id) : id(id) {}
+
+  Program(const Program&)            = delete;
+  Program& operator=(const Program&) = delete;
+
+  Program(Program&& other) noexcept { *this = std::move(other); }
+
+  Program& operator=(Program&& other) noexcept {
+    destroy();
+    id           = other.id;
+    status       = other.status;
+    pending      = std::move(other.pending);
+    generation   = other.generation;
+    instanceBase = other.instanceBase;
+    uniforms     = std::move(other.uniforms);
+    blocks       = std::move(other.blocks);
+    slots        = std::move(other.slots);
+    other.id     = 0;
+    return *this;
+  }
+
+  ~Program() { destroy(); }
+
+  void destroy() {
+    if (pending) {
+      for (GLuint shader : pending->shaders)
+        glDeleteShader(shader);
+      pending.reset();
+    }
+    if (id) {
+      glDeleteProgram(id);
+      gGLState.forgetProgram(id);
+      id = 0;
+    }
+  }
+  void use() const { gGLState.useProgram(id); }
+
+  // Takes over `next`'s GL program and reflection in place, so Materials and queued draws that
+  // point at this Program keep working. The old program is deleted; `generation` moves on so
+  // uniform locations resolved against it are re-resolved.
+  void replace(Program&& next) {
+    const uint32_t nextGeneration = generation + 1;
+    *this                         = std::move(next);
+    generation                    = nextGeneration;
+  }
+
+  bool ready() const { return status == LinkStatus::Ready; }
+
+  // Non-blocking: once the driver reports the link complete, checks the result, reflects the
+  // program and records it in its cache. Defined after ProgramCache.
+  LinkStatus poll();
+
+  // Location of `u_InstanceBase`, or -1. Programs that declare it read their model matrix from
+  // the instance SSBO (see kInstanceBinding) and RenderPass draws them instanced.
+  GLint instanceBase = -1;
+  bool  instanced() const { return instanceBase != -1; }
+
+  void setDebugName(const char* name) { glObjectLabel(GL_PROGRAM, id, -1, name); }
+  // ---- uniform setters ----
+  void set(UniformId u, int v) const { glUniform1i(uniformLocation(u), v); }
+
+  void set(UniformId u, float v) const { glUniform1f(uniformLocation(u), v); }
+
+  void setVec4(UniformId u, const float* v) const { glUniform4fv(uniformLocation(u), 1, v); }
+
+  void setMat4(UniformId u, const float* m) const {
+    glUniformMatrix4fv(uniformLocation(u), 1, GL_FALSE, m);
+  }
+
+  // ---- reflection ----
+  std::vector<UniformInfo> uniforms; // dense, in GL resource order
+  std::vector<BlockInfo>   blocks;
+  std::vector<uint16_t>    slots; // open-addressed by id, holds uniforms index + 1, 0 = empty
+
+  GLint uniformLocation(UniformId u) const {
+    const UniformInfo* info = findUniform(u);
+    return info ? info->location : -1;
+  }
+
+  GLint uniformLocation(std::string_view name) const {
+    return uniformLocation(UniformId::of(name));
+  }
+
+  const UniformInfo* findUniform(UniformId u) const {
+    if (slots.empty())
+      return nullptr;
+
+    const size_t mask = slots.size() - 1;
+    for (size_t i = u.value & mask;; i = (i + 1) & mask) {
+      uint16_t slot = slots[i];
+      if (slot == 0)
+        return nullptr;
+      if (uniforms[slot - 1].id == u.value)
+        return &uniforms[slot - 1];
+    }
+  }
+
+  const BlockInfo* findBlock(UniformId b, GLenum interface) const {
+    for (const BlockInfo& block : blocks)
+      if (block.id == b.value && block.interface == interface)
+        return &block;
+    return nullptr;
+  }
+
+  // Rebuilds the tables from the linked program. Called by ProgramPipe::build.
+  void reflect() {
+    uniforms.clear();
+    blocks.clear();
+    slots.clear();
+
+    std::string name;
+    auto        resourceName = [&](GLenum interface, GLuint index) {
+      GLint length = 0;
+      glGetProgramInterfaceiv(id, interface, GL_MAX_NAME_LENGTH, &length);
+      name.resize(std::max(length, 1));
+      GLsizei written = 0;
+      glGetProgramResourceName(id, interface, index, length, &written, name.data());
+      name.resize(written);
+      if (name.ends_with("[0]"))
+        name.resize(name.size() - 3);
+      return name;
+    };
+
+    GLint count = 0;
+    glGetProgramInterfaceiv(id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+    uniforms.reserve(count);
+
+    for (GLint i = 0; i < count; ++i) {
+      const GLenum props[] = {GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX, GL_OFFSET};
+      GLint        values[std::size(props)]{};
+      glGetProgramResourceiv(
+          id, GL_UNIFORM, i, std::size(props), props, std::size(props), nullptr, values);
+
+      std::string uniformName = resourceName(GL_UNIFORM, i);
+      uniforms.push_back({.id         = fnv1a(uniformName),
+                          .location   = values[0],
+                          .type       = static_cast<GLenum>(values[1]),
+                          .arraySize  = values[2],
+                          .blockIndex = values[3],
+                          .offset     = values[4],
+                          .name       = std::move(uniformName)});
+    }
+
+    for (GLenum interface : {GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK}) {
+      glGetProgramInterfaceiv(id, interface, GL_ACTIVE_RESOURCES, &count);
+      for (GLint i = 0; i < count; ++i) {
+        const GLenum props[] = {GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE};
+        GLint        values[2]{};
+        glGetProgramResourceiv(id, interface, i, 2, props, 2, nullptr, values);
+
+        std::string blockName = resourceName(interface, i);
+        blocks.push_back({.id        = fnv1a(blockName),
+                          .interface = interface,
+                          .index     = static_cast<GLuint>(i),
+                          .binding   = values[0],
+                          .dataSize  = values[1],
+                          .name      = std::move(blockName)});
+      }
+    }
+
+    ASSERT_ALWAYS(uniforms.size() < UINT16_MAX);
+    slots.assign(std::bit_ceil(uniforms.size() * 2 + 1), 0);
+    const size_t mask = slots.size() - 1;
+
+    for (size_t u = 0; u < uniforms.size(); ++u) {
+      size_t i = uniforms[u].id & mask;
+      while (slots[i] != 0) {
+        ASSERT_ALWAYS(uniforms[slots[i] - 1].id != uniforms[u].id && "uniform id collision");
+        i = (i + 1) & mask;
+      }
+      slots[i] = static_cast<uint16_t>(u + 1);
+    }
+
+    instanceBase = uniformLocation("u_InstanceBase"_uid);
+  }
+};
+
+// Uploads straight from the view's memory; nothing is copied on the way to glBufferData.
+inline Mesh buildMesh(const MeshView& view) {
+  Mesh mesh{};
+  glGenVertexArrays(1, &mesh.vao);
+  gGLState.bindVertexArray(mesh.vao);
+
+  glGenBuffers(1, &mesh.vbo);
+  gGLState.bindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+  glBufferData(GL_ARRAY_BUFFER, view.vertices.size(), view.vertices.data(), GL_STATIC_DRAW);
+  if (!view.indices.empty()) {
+    glGenBuffers(1, &mesh.ebo);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(
+        GL_ELEMENT_ARRAY_BUFFER, view.indices.size(), view.indices.data(), GL_STATIC_DRAW);
+  }
+
+  for (const auto& attr : view.attributes) {
+    glVertexAttribPointer(attr.location,
+                          attr.size,
+                          attr.type,
+                          attr.normalized,
+                          attr.stride,
+                          reinterpret_cast<void*>(attr.offset));
+    glEnableVertexAttribArray(attr.location);
+  }
+
+  gGLState.bindVertexArray(0);
+
+  mesh.indexCount = view.indexCount;
+  mesh.indexType  = view.indexType;
+  mesh.sortId     = mesh.vao;
+  mesh.bounds     = view.bounds.valid() ? view.bounds : computeBounds(view);
+  mesh.decode     = view.decode;
+  mesh.meshlets.assign(view.meshlets.begin(), view.meshlets.end());
+  mesh.lods.assign(view.lods.begin(), view.lods.end());
+  return mesh;
+}
+
+inline Mesh buildMesh(const MeshSpec& spec) { return buildMesh(viewOf(spec)); }
+
+// Many standalone meshes sharing one vertex and one index buffer allocation. Each mesh keeps its
+// own VAO (formats may differ) pointing at its range and owns only that; the batch owns the
+// buffers, so meshes may be moved out of it but must not outlive it.
+struct MeshBatch {
+  GLuint            vbo = 0;
+  GLuint            ebo = 0;
+  std::vector<Mesh> meshes;
+
+  MeshBatch() = default;
+
+  MeshBatch(const MeshBatch&)            = delete;
+  MeshBatch& operator=(const MeshBatch&) = delete;
+
+  MeshBatch(MeshBatch&& other) noexcept { *this = std::move(other); }
+
+  MeshBatch& operator=(MeshBatch&& other) noexcept {
+    destroy();
+    vbo    = std::exchange(other.vbo, 0);
+    ebo    = std::exchange(other.ebo, 0);
+    meshes = std::move(other.meshes);
+    return *this;
+  }
+
+  ~MeshBatch() { destroy(); }
+
+  void destroy() {
+    meshes.clear();
+    if (vbo) {
+      glDeleteBuffers(1, &vbo);
+      gGLState.forgetBuffer(vbo);
+    }
+    if (ebo) {
+      glDeleteBuffers(1, &ebo);
+      gGLState.forgetBuffer(ebo);
+    }
+    vbo = ebo = 0;
+  }
+};
+
+// Sizes the whole batch up front: one glGenVertexArrays, one glGenBuffers and one glBufferData
+// per buffer, then each view is written into its range straight from its own memory.
+inline MeshBatch buildMeshes(std::span<const MeshView> views) {
+  constexpr size_t kVertexAlignment = 16;
+
+  MeshBatch batch;
+  if (views.empty())
+    return batch;
+
+  // ranges of 16- and 32-bit indices may alternate, so every range starts 4-byte aligned
+  std::vector<size_t> vertexOffsets(views.size()), indexOffsets(views.size());
+  size_t              vertexBytes = 0, indexBytes = 0;
+  for (size_t i = 0; i < views.size(); ++i) {
+    vertexOffsets[i] = vertexBytes;
+    indexOffsets[i]  = indexBytes;
+    vertexBytes += (views[i].vertices.size() + kVertexAlignment - 1) & ~(kVertexAlignment - 1);
+    indexBytes += (views[i].indices.size() + 3) & ~size_t{3};
+  }
+
+  std::vector<GLuint> vaos(views.size());
+  glGenVertexArrays(static_cast<GLsizei>(vaos.size()), vaos.data());
+  GLuint buffers[2];
+  glGenBuffers(2, buffers);
+  batch.vbo = buffers[0];
+  batch.ebo = buffers[1];
+
+  // the element binding is VAO state, so the index storage is allocated through the first VAO
+  gGLState.bindVertexArray(vaos[0]);
+  gGLState.bindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+  gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+
+  batch.meshes.reserve(views.size());
+  for (size_t i = 0; i < views.size(); ++i) {
+    const MeshView& view = views[i];
+    Mesh&           mesh = batch.meshes.emplace_back();
+    mesh.vao             = vaos[i];
+    gGLState.bindVertexArray(mesh.vao);
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ebo);
+
+    glBufferSubData(
+        GL_ARRAY_BUFFER, vertexOffsets[i], view.vertices.size(), view.vertices.data());
+    if (!view.indices.empty())
+      glBufferSubData(
+          GL_ELEMENT_ARRAY_BUFFER, indexOffsets[i], view.indices.size(), view.indices.data());
+
+    for (const auto& attr : view.attributes) {
+      glVertexAttribPointer(attr.location,
+                            attr.size,
+                            attr.type,
+                            attr.normalized,
+                            attr.stride,
+                            reinterpret_cast<void*>(vertexOffsets[i] + attr.offset));
+      glEnableVertexAttribArray(attr.location);
+    }
+
+    mesh.indexCount = view.indexCount;
+    mesh.indexType  = view.indexType;
+    mesh.firstIndex = static_cast<GLuint>(indexOffsets[i] / componentSize(view.indexType));
+    mesh.sortId     = mesh.vao;
+    mesh.bounds     = view.bounds.valid() ? view.bounds : computeBounds(view);
+    mesh.decode     = view.decode;
+    mesh.meshlets.assign(view.meshlets.begin(), view.meshlets.end());
+    mesh.lods.assign(view.lods.begin(), view.lods.end());
+  }
+
+  gGLState.bindVertexArray(0);
+  return batch;
+}
+
+inline MeshBatch buildMeshes(std::span<const MeshSpec> specs) {
+  std::vector<MeshView> views;
+  views.reserve(specs.size());
+  for (const MeshSpec& spec : specs)
+    views.push_back(viewOf(spec));
+  return buildMeshes(views);
+}
+
+// Rvalue builder like RenderPassPipe: each step moves the pipe along instead of copying it, and
+// the streams are borrowed, not copied, so they must outlive build() (or the .spec taken out).
+// Generated streams can live in a MeshArena.
+struct MeshPipe {
+  MeshSpec spec;
+
+  MeshPipe()                      = default;
+  MeshPipe(MeshPipe&&)            = default;
+  MeshPipe& operator=(MeshPipe&&) = default;
+
+  MeshPipe(const MeshPipe&)            = delete;
+  MeshPipe& operator=(const MeshPipe&) = delete;
+
+  MeshPipe&& addVBO(std::span<const std::byte> bytes) && {
+    spec.buffers.push_back({GL_ARRAY_BUFFER, bytes});
+    return std::move(*this);
+  }
+
+  MeshPipe&& addVBO(const void* data, size_t size) && {
+    return std::move(*this).addVBO({static_cast<const std::byte*>(data), size});
+  }
+
+  MeshPipe&& addEBO(const void* data, size_t size, GLsizei indexCount) && {
+    spec.buffers.push_back({GL_ELEMENT_ARRAY_BUFFER, {static_cast<const std::byte*>(data), size}});
+    spec.indexCount = indexCount;
+    return std::move(*this);
+  }
+
+  MeshPipe&& addEBO(std::span<const GLuint> indices) && {
+    return std::move(*this).addEBO(
+        indices.data(), indices.size_bytes(), static_cast<GLsizei>(indices.size()));
+  }
+
+  MeshPipe&& addEBO(std::span<const uint16_t> indices) && {
+    spec.indexType = GL_UNSIGNED_SHORT;
+    return std::move(*this).addEBO(
+        indices.data(), indices.size_bytes(), static_cast<GLsizei>(indices.size()));
+  }
+
+  MeshPipe&& attrib(GLuint    location,
+                    GLint     size,
+                    GLenum    type,
+                    GLboolean normalized,
+                    GLsizei   stride,
+                    size_t    offset) && {
+    spec.attributes.push_back({location, size, type, normalized, stride, offset});
+    return std::move(*this);
+  }
+
+  Mesh build() && { return buildMesh(spec); }
+};
+
+// ---- geometry heap ----
+// Shared vertex and index buffers with a single vertex format. Meshes added to the heap are
+// sub-allocated ranges drawn with a base vertex and first index, so a whole frame can go out as
+// glMultiDrawElementsIndirect without switching VAOs.
+//
+// The heap VAO also carries a per-instance draw index at kDrawIndexLocation (an identity stream
+// with divisor 1), so each indirect command's baseInstance reaches the shader as
+//   layout(location = 15) in uint a_DrawIndex;   // baseInstance + gl_InstanceID
+//   mat4 model = u_Models[a_DrawIndex];
+// without relying on gl_DrawID / gl_BaseInstance (GL 4.6).
+constexpr GLuint kDrawIndexLocation = 15;
+
+struct GeometryHeapSpec {
+  std::vector<VertexAttribute> attributes;
+  size_t                       vertexCapacity = 0;
+  size_t                       indexCapacity  = 0;
+};
+
+inline uint32_t nextGeometryHeapId() {
+  static uint32_t next = 1;
+  return next++;
+}
+
+struct GeometryHeap {
+  uint32_t id = 0; // stays with the heap across moves; Mesh::heapId refers to it
+
+  GLuint vao       = 0;
+  GLuint vbo       = 0;
+  GLuint ebo       = 0;
+  GLuint drawIndex = 0;
+
+  std::vector<VertexAttribute> attributes;
+  GLsizei                      stride            = 0;
+  size_t                       vertexCapacity    = 0;
+  size_t                       indexCapacity     = 0;
+  size_t                       vertexCount       = 0;
+  size_t                       indexCount        = 0;
+  size_t                       drawIndexCapacity = 0;
+  uint32_t                     meshCount         = 0;
+
+  GeometryHeap() = default;
+
+  GeometryHeap(const GeometryHeap&)            = delete;
+  GeometryHeap& operator=(const GeometryHeap&) = delete;
+
+  GeometryHeap(GeometryHeap&& other) noexcept { *this = std::move(other); }
+
+  GeometryHeap& operator=(GeometryHeap&& other) noexcept {
+    destroy();
+    id                = std::exchange(other.id, 0);
+    vao               = other.vao;
+    vbo               = other.vbo;
+    ebo               = other.ebo;
+    drawIndex         = other.drawIndex;
+    attributes        = std::move(other.attributes);
+    stride            = other.stride;
+    vertexCapacity    = other.vertexCapacity;
+    indexCapacity     = other.indexCapacity;
+    vertexCount       = other.vertexCount;
+    indexCount        = other.indexCount;
+    drawIndexCapacity = other.drawIndexCapacity;
+    meshCount         = other.meshCount;
+
+    other.vao = other.vbo = other.ebo = other.drawIndex = 0;
+    return *this;
+  }
+
+  bool matchesFormat(std::span<const VertexAttribute> attrs) const {
+    if (attrs.size() != attributes.size())
+      return false;
+    return std::ranges::all_of(attrs, [&](const VertexAttribute& a) {
+      return std::ranges::any_of(attributes, [&](const VertexAttribute& b) {
+        return a.location == b.location && a.size == b.size && a.type == b.type &&
+               a.normalized == b.normalized && a.stride == b.stride && a.offset == b.offset;
+      });
+    });
+  }
+
+  // Copies one vertex and one index stream into the heap, straight from the view's memory. The
+  // attributes must match the heap's vertex format; indices stay relative to the mesh's own
+  // vertices. The heap draws GLuint indices, so 16-bit ones are widened on the way in.
+  Mesh add(const MeshView& view) {
+    ASSERT_ALWAYS(vao);
+    ASSERT_ALWAYS(!view.vertices.empty() && !view.indices.empty());
+    ASSERT_ALWAYS(matchesFormat(view.attributes));
+
+    // every level of detail rides along after the full mesh's indices
+    size_t meshVertices = view.vertices.size() / stride;
+    size_t meshIndices  = view.indices.size() / componentSize(view.indexType);
+    ASSERT_ALWAYS(static_cast<size_t>(view.indexCount) <= meshIndices);
+
+    std::span<const std::byte> indices = view.indices;
+    std::vector<GLuint>        widened;
+    if (view.indexType == GL_UNSIGNED_SHORT) {
+      widened.resize(meshIndices);
+      for (size_t i = 0; i < meshIndices; ++i) {
+        uint16_t index;
+        std::memcpy(&index, view.indices.data() + i * sizeof(index), sizeof(index));
+        widened[i] = index;
+      }
+      indices = std::as_bytes(std::span(widened));
+    } else
+      ASSERT_ALWAYS(view.indexType == GL_UNSIGNED_INT);
+    ASSERT_ALWAYS(vertexCount + meshVertices <= vertexCapacity);
+    ASSERT_ALWAYS(indexCount + meshIndices <= indexCapacity);
+
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(
+        GL_ARRAY_BUFFER, vertexCount * stride, view.vertices.size(), view.vertices.data());
+    // the element binding is VAO state; upload through a neutral target instead
+    gGLState.bindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    indexCount * sizeof(GLuint),
+                    meshIndices * sizeof(GLuint),
+                    indices.data());
+
+    Mesh mesh{};
+    mesh.vao        = vao;
+    mesh.heapId     = id;
+    mesh.indexCount = view.indexCount;
+    mesh.baseVertex = static_cast<GLint>(vertexCount);
+    mesh.firstIndex = static_cast<GLuint>(indexCount);
+    mesh.sortId     = meshCount++;
+    mesh.bounds     = view.bounds.valid() ? view.bounds : computeBounds(view);
+    mesh.decode     = view.decode;
+    mesh.meshlets.assign(view.meshlets.begin(), view.meshlets.end());
+    mesh.lods.assign(view.lods.begin(), view.lods.end());
+
+    vertexCount += meshVertices;
+    indexCount += meshIndices;
+    return mesh;
+  }
+
+  Mesh add(const MeshSpec& spec) { return add(viewOf(spec)); }
+
+  // Grows the identity draw-index stream to cover `count` instances per frame.
+  void reserveDrawIndices(size_t count) {
+    if (count <= drawIndexCapacity)
+      return;
+
+    drawIndexCapacity = std::bit_ceil(count);
+    std::vector<GLuint> identity(drawIndexCapacity);
+    for (size_t i = 0; i < identity.size(); ++i)
+      identity[i] = static_cast<GLuint>(i);
+
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, drawIndex);
+    glBufferData(
+        GL_ARRAY_BUFFER, identity.size() * sizeof(GLuint), identity.data(), GL_STATIC_DRAW);
+  }
+
+  void destroy() {
+    if (vao) {
+      glDeleteVertexArrays(1, &vao);
+      gGLState.forgetVertexArray(vao);
+    }
+    for (GLuint* buf : {&vbo, &ebo, &drawIndex}) {
+      if (*buf) {
+        glDeleteBuffers(1, buf);
+        gGLState.forgetBuffer(*buf);
+      }
+    }
+    vao = vbo = ebo = drawIndex = 0;
+    id                          = 0;
+  }
+
+  ~GeometryHeap() { destroy(); }
+};
+
+struct GeometryHeapPipe {
+  GeometryHeapSpec spec;
+
+  GeometryHeapPipe attrib(GLuint    location,
+                          GLint     size,
+                          GLenum    type,
+                          GLboolean normalized,
+                          GLsizei   stride,
+                          size_t    offset) const {
+    GeometryHeapPipe next = *this;
+    next.spec.attributes.push_back({location, size, type, normalized, stride, offset});
+    return next;
+  }
+
+  GeometryHeapPipe capacity(size_t vertices, size_t indices) const {
+    GeometryHeapPipe next    = *this;
+    next.spec.vertexCapacity = vertices;
+    next.spec.indexCapacity  = indices;
+    return next;
+  }
+
+  GeometryHeap build() const {
+    ASSERT_ALWAYS(!spec.attributes.empty());
+    ASSERT_ALWAYS(spec.vertexCapacity > 0 && spec.indexCapacity > 0);
+
+    GeometryHeap heap;
+    heap.id             = nextGeometryHeapId();
+    heap.attributes     = spec.attributes;
+    heap.stride         = spec.attributes.front().stride;
+    heap.vertexCapacity = spec.vertexCapacity;
+    heap.indexCapacity  = spec.indexCapacity;
+    for (const auto& attr : spec.attributes)
+      ASSERT_ALWAYS(attr.stride == heap.stride && attr.location != kDrawIndexLocation);
+
+    glGenVertexArrays(1, &heap.vao);
+    glGenBuffers(1, &heap.vbo);
+    glGenBuffers(1, &heap.ebo);
+    glGenBuffers(1, &heap.drawIndex);
+    gGLState.bindVertexArray(heap.vao);
+
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, heap.vbo);
+    glBufferData(GL_ARRAY_BUFFER, spec.vertexCapacity * heap.stride, nullptr, GL_STATIC_DRAW);
+    for (const auto& attr : spec.attributes) {
+      glVertexAttribPointer(attr.location,
+                            attr.size,
+                            attr.type,
+                            attr.normalized,
+                            attr.stride,
+                            reinterpret_cast<void*>(attr.offset));
+      glEnableVertexAttribArray(attr.location);
+    }
+
+    gGLState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, heap.ebo);
+    glBufferData(
+        GL_ELEMENT_ARRAY_BUFFER, spec.indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+    heap.reserveDrawIndices(1024);
+    gGLState.bindBuffer(GL_ARRAY_BUFFER, heap.drawIndex);
+    glVertexAttribIPointer(kDrawIndexLocation, 1, GL_UNSIGNED_INT, 0, nullptr);
+    glVertexAttribDivisor(kDrawIndexLocation, 1);
+    glEnableVertexAttribArray(kDrawIndexLocation);
+
+    gGLState.bindVertexArray(0);
+    return heap;
+  }
+};
+
+// ---- mesh files ----
+// .tmesh holds one mesh's streams exactly as they are uploaded, plus its vertex format and
+// bounds. Loading is an mmap, a header check and glBufferData straight out of the mapping: no
+// parsing, no heap copies and no pass over the vertices for bounds.
+//
+// File layout, little-endian:
+//   TMeshHeader
+//   TMeshAttribute[attributeCount]
+//   vertex stream at vertexOffset, index stream (indexType) at indexOffset; both
+//   kTMeshAlignment-aligned
+struct TMeshHeader {
+  static constexpr uint32_t kMagic   = 0x48534D54; // "TMSH"
+  static constexpr uint32_t kVersion = 2;            // 2: index type and position decode
+
+  uint32_t  magic          = kMagic;
+  uint32_t  version        = kVersion;
+  uint32_t  attributeCount = 0;
+  uint32_t  indexCount     = 0;
+  uint64_t  vertexOffset   = 0;
+  uint64_t  vertexSize     = 0;
+  uint64_t  indexOffset    = 0;
+  uint64_t  indexSize      = 0;
+  glm::vec3 boundsMin{0.0f};
+  glm::vec3 boundsMax{0.0f};
+  glm::vec3 center{0.0f};
+  float     radius    = -1.0f;
+  uint32_t  indexType = GL_UNSIGNED_INT;
+  glm::vec3 decodeScale{1.0f};
+  glm::vec3 decodeOffset{0.0f};
+  uint32_t  reserved = 0;
+};
+
+struct TMeshAttribute {
+  uint32_t location;
+  int32_t  size;
+  uint32_t type;
+  uint32_t normalized;
+  uint32_t stride;
+  uint32_t offset;
+};
+static_assert(sizeof(TMeshHeader) == 120 && sizeof(TMeshAttribute) == 24);
+
+constexpr size_t kTMeshAlignment = 64;
+
+// A mapped .tmesh file; `view` points into the mapping and is valid while the file is open.
+//   TMeshFile file("rock.tmesh");
+//   Mesh      rock = buildMesh(file.view);
+struct TMeshFile {
+  MappedFile                   file;
+  std::vector<VertexAttribute> attributes;
+  MeshView                     view;
+
+  // Throws on a missing, truncated or foreign file.
+  explicit TMeshFile(const std::string& path) {
+    auto fail = [&](std::string_view why) {
+      throw std::runtime_error(std::format("Invalid mesh file {}: {}", path, why));
+    };
+
+    if (!file.open(path))
+      throw std::runtime_error("Failed to open mesh file: " + path);
+#ifndef _WIN32
+    // everything is about to be read once, front to back
+    ::madvise(const_cast<std::byte*>(file.data), file.size, MADV_WILLNEED);
+#endif
+
+    TMeshHeader header;
+    if (file.size < sizeof(header))
+      fail("truncated header");
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.magic != TMeshHeader::kMagic)
+      fail("not a .tmesh file");
+    if (header.version != TMeshHeader::kVersion)
+      fail(std::format("version {}, expected {}", header.version, TMeshHeader::kVersion));
+
+    auto inFile = [&](uint64_t offset, uint64_t size) {
+      return offset <= file.size && size <= file.size - offset;
+    };
+    if (!inFile(sizeof(header), uint64_t{header.attributeCount} * sizeof(TMeshAttribute)) ||
+        !inFile(header.vertexOffset, header.vertexSize) ||
+        !inFile(header.indexOffset, header.indexSize))
+      fail("stream outside the file");
+    if (header.vertexOffset % kTMeshAlignment || header.indexOffset % kTMeshAlignment)
+      fail("misaligned stream");
+    if (header.indexType != GL_UNSIGNED_INT && header.indexType != GL_UNSIGNED_SHORT)
+      fail("unsupported index type");
+    if (uint64_t{header.indexCount} * componentSize(header.indexType) > header.indexSize ||
+        header.indexCount > uint32_t(std::numeric_limits<GLsizei>::max()))
+      fail("index count exceeds the index stream");
+
+    attributes.reserve(header.attributeCount);
+    for (uint32_t i = 0; i < header.attributeCount; ++i) {
+      TMeshAttribute a;
+      std::memcpy(&a, file.data + sizeof(header) + i * sizeof(TMeshAttribute), sizeof(a));
+      attributes.push_back({.location   = a.location,
+                            .size       = a.size,
+                            .type       = a.type,
+                            .normalized = static_cast<GLboolean>(a.normalized),
+                            .stride     = static_cast<GLsizei>(a.stride),
+                            .offset     = a.offset});
+    }
+
+    view = {.vertices   = {file.data + header.vertexOffset, header.vertexSize},
+            .indices    = {file.data + header.indexOffset, header.indexSize},
+            .attributes = attributes,
+            .indexCount = static_cast<GLsizei>(header.indexCount),
+            .indexType  = header.indexType,
+            .bounds     = {.min    = header.boundsMin,
+                           .max    = header.boundsMax,
+                           .center = header.center,
+                           .radius = header.radius},
+            .decode     = {.scale = header.decodeScale, .offset = header.decodeOffset}};
+  }
+};
+
+// Writes `mesh` as a .tmesh file, computing its bounds when the view carries none. For offline
+// conversion; the streams are stored as they are.
+inline bool writeTMesh(const std::string& path, const MeshView& mesh) {
+  const Bounds bounds = mesh.bounds.valid() ? mesh.bounds : computeBounds(mesh);
+  auto         align  = [](uint64_t n) {
+    return (n + kTMeshAlignment - 1) & ~uint64_t{kTMeshAlignment - 1};
+  };
+
+  TMeshHeader header;
+  header.attributeCount = static_cast<uint32_t>(mesh.attributes.size());
+  header.indexCount     = static_cast<uint32_t>(mesh.indexCount);
+  header.vertexOffset   = align(sizeof(header) + mesh.attributes.size() * sizeof(TMeshAttribute));
+  header.vertexSize     = mesh.vertices.size();
+  header.indexOffset    = align(header.vertexOffset + header.vertexSize);
+  header.indexSize      = mesh.indices.size();
+  header.boundsMin      = bounds.min;
+  header.boundsMax      = bounds.max;
+  header.center         = bounds.center;
+  header.radius         = bounds.radius;
+  header.indexType      = mesh.indexType;
+  header.decodeScale    = mesh.decode.scale;
+  header.decodeOffset   = mesh.decode.offset;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    LOGF_WARN("writeTMesh: cannot write {}", path);
+    return false;
+  }
+
+  auto write = [&](const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  };
+  auto padTo = [&](uint64_t offset) {
+    static constexpr std::array<char, kTMeshAlignment> zeros{};
+    write(zeros.data(), offset - static_cast<uint64_t>(out.tellp()));
+  };
+
+  write(&header, sizeof(header));
+  for (const VertexAttribute& a : mesh.attributes) {
+    const TMeshAttribute attribute{.location   = a.location,
+                                   .size       = a.size,
+                                   .type       = a.type,
+                                   .normalized = a.normalized,
+                                   .stride     = static_cast<uint32_t>(a.stride),
+                                   .offset     = static_cast<uint32_t>(a.offset)};
+    write(&attribute, sizeof(attribute));
+  }
+  padTo(header.vertexOffset);
+  write(mesh.vertices.data(), mesh.vertices.size());
+  padTo(header.indexOffset);
+  write(mesh.indices.data(), mesh.indices.size());
+
+  if (!out) {
+    LOGF_WARN("writeTMesh: failed writing {}", path);
+    return false;
+  }
+  return true;
+}
+
+// ---- parallel work ----
+// Timing for the reports of the import and warm-up passes.
+using Clock = std::chrono::steady_clock;
+
+inline double elapsedMs(Clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// Runs work(i) for every i in [0, n) on up to `threads` threads (0: one per core), the calling
+// thread included, each taking the next unclaimed index. Returns once all are done.
+template <typename Work>
+void runEach(size_t n, size_t threads, Work&& work) {
+  const size_t        cores   = std::max(std::thread::hardware_concurrency(), 1u);
+  const size_t        workers = std::min<size_t>(threads ? threads : cores, n);
+  std::atomic<size_t> next{0};
+  auto                claim = [&] {
+    for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+      work(i);
+  };
+
+  std::vector<std::jthread> pool;
+  for (size_t w = 1; w < workers; ++w)
+    pool.emplace_back(claim);
+  claim();
+}
+
+// Slices worth running for `n` items when each thread should get at least `grain` of them.
+inline size_t sliceCount(size_t n, size_t grain) {
+  size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  return std::clamp<size_t>((n + grain - 1) / grain, 1, cores);
+}
+
+// Runs work(slice, begin, end) over [cuts[s], cuts[s + 1]) for every slice, the first one on the
+// calling thread. Returns once all slices are done.
+template <typename Work>
+void runSlices(std::span<const size_t> cuts, Work&& work) {
+  if (cuts.size() < 2)
+    return;
+
+  std::vector<std::jthread> workers;
+  workers.reserve(cuts.size() - 2);
+  for (size_t s = 1; s + 1 < cuts.size(); ++s)
+    workers.emplace_back([&work, cuts, s] { work(s, cuts[s], cuts[s + 1]); });
+  work(size_t{0}, cuts[0], cuts[1]);
+}
+
+// ---- mesh optimization ----
+// Import-time reordering for vertex-bound meshes, run on the CPU copy before upload:
+//   1. Tipsify (Sander et al. 2007) orders triangles for the post-transform vertex cache,
+//   2. the result is cut into clusters that are drawn outside-in to cut overdraw, giving up at
+//      most overdrawThreshold times each cluster's ACMR,
+//   3. vertices are renumbered in first-use order so fetches walk the vertex buffer forwards.
+// ACMR is transformed vertices per triangle (0.5 on a large regular grid, 3 at worst); ATVR is
+// transformed vertices per vertex (1 is ideal). Both are measured on a FIFO of cacheSize entries.
+//
+//   MeshOptimizeReport report = MeshOptimizer{}.run(meshes); // one mesh per worker at a time
+
+// Writable streams of one mesh, e.g. in a MeshArena, for passes that rewrite them in place.
+struct MeshData {
+  std::span<std::byte>             vertices; // interleaved, one stride for every attribute
+  std::span<GLuint>                indices;
+  std::span<const VertexAttribute> attributes;
+
+  MeshView view() const {
+    return {.vertices   = vertices,
+            .indices    = std::as_bytes(indices),
+            .attributes = attributes,
+            .indexCount = static_cast<GLsizei>(indices.size())};
+  }
+};
+
+struct MeshOptimizeStats {
+  float  acmrBefore = 0, acmrAfter = 0;
+  float  atvrBefore = 0, atvrAfter = 0;
+  size_t triangles  = 0;
+  size_t vertices   = 0; // referenced vertices; the rest are dropped by the fetch remap
+  size_t clusters   = 0; // overdraw clusters, 0 when the pass did not run
+  double ms         = 0;
+};
+
+struct MeshOptimizeReport {
+  std::vector<MeshOptimizeStats> meshes; // in input order
+  float                          acmrBefore = 0, acmrAfter = 0; // weighted by triangles
+  float                          atvrBefore = 0, atvrAfter = 0; // weighted by vertices
+  double                         totalMs    = 0;
+};
+
+struct MeshOptimizer {
+  uint32_t cacheSize         = 16;    // post-transform cache entries to optimize for
+  float    overdrawThreshold = 1.05f; // below 1 skips the overdraw pass
+  bool     remapVertices     = true;
+  size_t   threads           = 0; // 0: one per core
+
+  // Reorders `mesh` in place. Its vertex span shrinks when vertices turn out to be unreferenced.
+  MeshOptimizeStats optimize(MeshData& mesh) const {
+    const auto        start = Clock::now();
+    MeshOptimizeStats stats;
+    ASSERT_ALWAYS(mesh.indices.size() % 3 == 0 && cacheSize > 0);
+
+    const size_t stride      = vertexStride(mesh.attributes);
+    const size_t vertexCount = stride ? mesh.vertices.size() / stride : 0;
+    for (GLuint index : mesh.indices)
+      ASSERT_ALWAYS(index < vertexCount && "index past the end of the vertex stream");
+
+    stats.triangles = mesh.indices.size() / 3;
+    stats.vertices  = referencedVertices(mesh.indices, vertexCount);
+    if (stats.triangles == 0)
+      return stats;
+
+    const uint32_t misses = simulate(mesh.indices, vertexCount);
+    stats.acmrBefore      = float(misses) / float(stats.triangles);
+    stats.atvrBefore      = float(misses) / float(stats.vertices);
+
+    std::vector<size_t> clusters;
+    std::vector<GLuint> order = tipsify(mesh.indices, vertexCount, clusters);
+    if (overdrawThreshold >= 1.0f && hasPositions(mesh.attributes)) {
+      splitClusters(order, vertexCount, clusters);
+      order          = sortClusters(order, clusters, mesh);
+      stats.clusters = clusters.size();
+    }
+    std::ranges::copy(order, mesh.indices.begin());
+
+    if (remapVertices && stride)
+      remap(mesh, stride, vertexCount);
+
+    const uint32_t after = simulate(mesh.indices, vertexCount);
+    stats.acmrAfter      = float(after) / float(stats.triangles);
+    stats.atvrAfter      = float(after) / float(stats.vertices);
+    stats.ms             = elapsedMs(start);
+    return stats;
+  }
+
+  // Optimizes every mesh in parallel, see runEach. Logs nothing; callers print the report.
+  MeshOptimizeReport run(std::span<MeshData> meshes) const {
+    const auto         start = Clock::now();
+    MeshOptimizeReport report;
+    report.meshes.resize(meshes.size());
+    runEach(meshes.size(), threads, [&](size_t i) { report.meshes[i] = optimize(meshes[i]); });
+
+    double triangles = 0, vertices = 0;
+    for (const MeshOptimizeStats& mesh : report.meshes) {
+      report.acmrBefore += mesh.acmrBefore * float(mesh.triangles);
+      report.acmrAfter += mesh.acmrAfter * float(mesh.triangles);
+      report.atvrBefore += mesh.atvrBefore * float(mesh.vertices);
+      report.atvrAfter += mesh.atvrAfter * float(mesh.vertices);
+      triangles += double(mesh.triangles);
+      vertices += double(mesh.vertices);
+    }
+    if (triangles > 0) {
+      report.acmrBefore /= float(triangles);
+      report.acmrAfter /= float(triangles);
+    }
+    if (vertices > 0) {
+      report.atvrBefore /= float(vertices);
+      report.atvrAfter /= float(vertices);
+    }
+
+    report.totalMs = elapsedMs(start);
+    return report;
+  }
+
+private:
+  // FIFO post-transform cache on timestamps: a vertex is resident while fewer than `size`
+  // misses happened since it was loaded, and flush() empties it in O(1).
+  struct VertexCache {
+    std::vector<uint32_t> loaded;
+    uint32_t              size;
+    uint32_t              time;
+
+    VertexCache(size_t vertexCount, uint32_t size)
+        : loaded(vertexCount, 0), size(size), time(size + 1) {}
+
+    bool touch(GLuint v) {
+      if (time - loaded[v] <= size)
+        return false;
+      loaded[v] = time++;
+      return true;
+    }
+
+    uint32_t triangle(const GLuint* t) { return touch(t[0]) + touch(t[1]) + touch(t[2]); }
+
+    void flush() { time += size + 1; }
+  };
+
+  uint32_t simulate(std::span<const GLuint> indices, size_t vertexCount) const {
+    VertexCache cache(vertexCount, cacheSize);
+    uint32_t    misses = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+      misses += cache.triangle(&indices[i]);
+    return misses;
+  }
+
+  static size_t referencedVertices(std::span<const GLuint> indices, size_t vertexCount) {
+    std::vector<uint8_t> seen(vertexCount, 0);
+    size_t               count = 0;
+    for (GLuint v : indices)
+      count += std::exchange(seen[v], uint8_t{1}) == 0;
+    return count;
+  }
+
+  static const VertexAttribute* positionOf(std::span<const VertexAttribute> attributes) {
+    auto position = std::ranges::find(attributes, GLuint{0}, &VertexAttribute::location);
+    if (position == attributes.end() || position->type != GL_FLOAT || position->size < 3)
+      return nullptr;
+    return &*position;
+  }
+
+  static bool hasPositions(std::span<const VertexAttribute> attributes) {
+    return positionOf(attributes) != nullptr;
+  }
+
+  // Fans around one vertex at a time, moving on to the neighbour that stays cached longest
+  // while its remaining triangles are emitted. Where no neighbour qualifies the walk restarts
+  // from the dead-end stack; `clusters` receives the first triangle of every such restart.
+  std::vector<GLuint> tipsify(std::span<const GLuint> indices,
+                              size_t                  vertexCount,
+                              std::vector<size_t>&    clusters) const {
+    const size_t          triangles = indices.size() / 3;
+    std::vector<uint32_t> live(vertexCount, 0); // triangles not yet emitted, per vertex
+    for (GLuint v : indices)
+      ++live[v];
+
+    std::vector<uint32_t> first(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+      first[v + 1] = first[v] + live[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+      std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+      for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    VertexCache          cache(vertexCount, cacheSize);
+    std::vector<uint8_t> emitted(triangles, 0);
+    std::vector<GLuint>  deadEnd, candidates, order;
+    order.reserve(indices.size());
+    size_t cursor = 0;
+
+    auto restart = [&]() -> int64_t {
+      while (!deadEnd.empty()) {
+        GLuint v = deadEnd.back();
+        deadEnd.pop_back();
+        if (live[v] > 0)
+          return v;
+      }
+      for (; cursor < vertexCount; ++cursor)
+        if (live[cursor] > 0)
+          return int64_t(cursor);
+      return -1;
+    };
+
+    clusters.assign(1, 0);
+    for (int64_t fan = restart(); fan >= 0;) {
+      candidates.clear();
+      for (uint32_t a = first[fan]; a < first[fan + 1]; ++a) {
+        const uint32_t t = adjacency[a];
+        if (emitted[t])
+          continue;
+        emitted[t] = 1;
+        for (GLuint v : indices.subspan(size_t(t) * 3, 3)) {
+          order.push_back(v);
+          deadEnd.push_back(v);
+          candidates.push_back(v);
+          --live[v];
+          cache.touch(v);
+        }
+      }
+
+      int64_t best = -1, bestPriority = -1;
+      for (GLuint v : candidates) {
+        if (live[v] == 0)
+          continue;
+        // a vertex that would be evicted before its fan is done is no better than a new one
+        const int64_t age      = int64_t(cache.time) - int64_t(cache.loaded[v]);
+        const int64_t priority = age + 2 * int64_t(live[v]) <= int64_t(cacheSize) ? age : 0;
+        if (priority > bestPriority) {
+          best         = v;
+          bestPriority = priority;
+        }
+      }
+      if (best < 0) {
+        best = restart();
+        if (best >= 0)
+          clusters.push_back(order.size() / 3);
+      }
+      fan = best;
+    }
+    return order;
+  }
+
+  // Cuts each restart cluster again wherever its running ACMR from the last cut is already
+  // within overdrawThreshold of the whole cluster's, leaving small clusters to sort.
+  void splitClusters(std::span<const GLuint> order,
+                     size_t                  vertexCount,
+                     std::vector<size_t>&    clusters) const {
+    VertexCache         cache(vertexCount, cacheSize);
+    std::vector<size_t> cuts;
+    const size_t        triangles = order.size() / 3;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+      const size_t begin = clusters[c];
+      const size_t end   = c + 1 < clusters.size() ? clusters[c + 1] : triangles;
+
+      cache.flush();
+      uint32_t misses = 0;
+      for (size_t t = begin; t < end; ++t)
+        misses += cache.triangle(&order[t * 3]);
+      const float target = overdrawThreshold * float(misses) / float(end - begin);
+
+      cuts.push_back(begin);
+      cache.flush();
+      uint32_t running = 0;
+      size_t   from    = begin;
+      for (size_t t = begin; t < end; ++t) {
+        running += cache.triangle(&order[t * 3]);
+        if (t + 1 < end && float(running) <= target * float(t + 1 - from)) {
+          cuts.push_back(t + 1);
+          cache.flush();
+          running = 0;
+          from    = t + 1;
+        }
+      }
+    }
+    clusters = std::move(cuts);
+  }
+
+  // Clusters facing away from the mesh center go first: they are the likeliest occluders.
+  static std::vector<GLuint> sortClusters(std::span<const GLuint> order,
+                                          std::span<const size_t> clusters,
+                                          const MeshData&         mesh) {
+    const VertexAttribute* position = positionOf(mesh.attributes);
+    const size_t           stride   = vertexStride(mesh.attributes);
+    auto                   read     = [&](GLuint v) {
+      glm::vec3 p;
+      std::memcpy(&p, mesh.vertices.data() + position->offset + size_t(v) * stride, sizeof(p));
+      return p;
+    };
+
+    glm::dvec3 meshCenter{0.0};
+    for (GLuint v : order)
+      meshCenter += glm::dvec3(read(v));
+    meshCenter /= double(order.size());
+
+    const size_t       triangles = order.size() / 3;
+    std::vector<float> facing(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c) {
+      const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles;
+      glm::vec3    normal{0.0f}, center{0.0f}, centroid{0.0f};
+      float        area = 0.0f;
+      for (size_t t = clusters[c]; t < end; ++t) {
+        glm::vec3 a = read(order[t * 3]), b = read(order[t * 3 + 1]), d = read(order[t * 3 + 2]);
+        glm::vec3 n = glm::cross(b - a, d - a); // twice the area along the normal
+        float     w = glm::length(n);
+        normal += n;
+        center += (a + b + d) * w;
+        centroid += a + b + d;
+        area += w;
+      }
+      center    = area > 0.0f ? center / (3.0f * area)
+                                : centroid / (3.0f * float(end - clusters[c]));
+      float len = glm::length(normal);
+      facing[c] = len > 0.0f ? glm::dot(center - glm::vec3(meshCenter), normal / len) : 0.0f;
+    }
+
+    std::vector<size_t> sorted(clusters.size());
+    std::iota(sorted.begin(), sorted.end(), size_t{0});
+    std::ranges::stable_sort(sorted, std::greater{}, [&](size_t c) { return facing[c]; });
+
+    std::vector<GLuint> out;
+    out.reserve(order.size());
+    for (size_t c : sorted) {
+      const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles;
+      out.insert(out.end(), order.begin() + clusters[c] * 3, order.begin() + end * 3);
+    }
+    return out;
+  }
+
+  // Renumbers vertices in first-use order and compacts the vertex stream to match.
+  static void remap(MeshData& mesh, size_t stride, size_t vertexCount) {
+    std::vector<GLuint> remap(vertexCount, UINT32_MAX);
+    GLuint              next = 0;
+    for (GLuint& index : mesh.indices) {
+      if (remap[index] == UINT32_MAX)
+        remap[index] = next++;
+      index = remap[index];
+    }
+
+    std::vector<std::byte> scratch(size_t(next) * stride);
+    for (size_t v = 0; v < vertexCount; ++v)
+      if (remap[v] != UINT32_MAX)
+        std::memcpy(scratch.data() + remap[v] * stride, mesh.vertices.data() + v * stride, stride);
+    std::ranges::copy(scratch, mesh.vertices.begin());
+    mesh.vertices = mesh.vertices.first(scratch.size());
+  }
+};
+
+// ---- vertex encoding ----
+// Packs float vertex streams into compact fetch formats and picks 16-bit indices when every
+// vertex is addressable with them:
+//   position  (location 0, float3)  snorm16 x3 inside the cube around the mesh's AABB, or
+//                                    half x3 about its center; the view's PositionDecode
+//                                    restores object space
+//   normal, tangent (float3/float4)  octahedral snorm16 x2; a float4 tangent keeps its
+//                                    handedness as a third component of +-1
+//   uv        (float2)               half x2
+// Other attributes are copied as they are. Every attribute starts on 4 bytes, so a float
+// position + normal + uv vertex shrinks from 32 to 16 bytes. Shaders read positions unchanged;
+// normals and tangents go through kOctahedralGLSL:
+//   layout(location = 1) in vec2 a_Normal;
+//   vec3 normal = octDecode(a_Normal);
+
+constexpr const char* kOctahedralGLSL = R"GLSL(
+vec3 octDecode(vec2 e) {
+  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (v.z < 0.0)
+    v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+  return normalize(v);
+}
+)GLSL";
+
+struct VertexEncoder {
+  bool   halfPositions   = false; // half floats about the center instead of snorm16 in the cube
+  bool   shortIndices    = true;  // GL_UNSIGNED_SHORT when the vertex count allows
+  GLuint normalLocation  = 1;
+  GLuint tangentLocation = 2;
+  GLuint uvLocation      = 3;
+
+  // Encodes a float mesh with GLuint indices. The result borrows its vertices, attributes and
+  // narrowed indices from `arena`; 32-bit indices that stay 32-bit are borrowed from `mesh`.
+  MeshView encode(const MeshView& mesh, MeshArena& arena) const {
+    ASSERT_ALWAYS(mesh.indexType == GL_UNSIGNED_INT && mesh.decode.identity());
+    const size_t inStride    = vertexStride(mesh.attributes);
+    const size_t vertexCount = inStride ? mesh.vertices.size() / inStride : 0;
+    const Bounds bounds      = mesh.bounds.valid() ? mesh.bounds : computeBounds(mesh);
+
+    MeshView out{.indexCount = mesh.indexCount,
+                 .bounds     = bounds,
+                 .meshlets   = mesh.meshlets,
+                 .lods       = mesh.lods};
+    std::span<VertexAttribute> attributes = arena.allocate<VertexAttribute>(mesh.attributes.size());
+    std::vector<Packing>       packings(attributes.size());
+
+    size_t stride = 0;
+    for (size_t a = 0; a < attributes.size(); ++a) {
+      const VertexAttribute& in = mesh.attributes[a];
+      VertexAttribute&       to = attributes[a];
+      const bool             f  = in.type == GL_FLOAT && !in.normalized;
+
+      to        = in;
+      to.offset = stride;
+      if (f && in.location == 0 && in.size == 3 && bounds.valid()) {
+        packings[a]   = Packing::Position;
+        to.type       = halfPositions ? GL_HALF_FLOAT : GL_SHORT;
+        to.normalized = !halfPositions;
+        stride += 8;
+      } else if (f && (in.location == normalLocation || in.location == tangentLocation) &&
+                 in.size >= 3) {
+        packings[a]   = Packing::Direction;
+        to.size       = in.size == 4 ? 3 : 2;
+        to.type       = GL_SHORT;
+        to.normalized = GL_TRUE;
+        stride += in.size == 4 ? 8 : 4;
+      } else if (f && in.location == uvLocation && in.size == 2) {
+        packings[a] = Packing::Uv;
+        to.type     = GL_HALF_FLOAT;
+        stride += 4;
+      } else {
+        packings[a] = Packing::Copy;
+        stride += (in.size * componentSize(in.type) + 3) & ~size_t{3};
+      }
+    }
+    for (VertexAttribute& to : attributes)
+      to.stride = static_cast<GLsizei>(stride);
+
+    // snorm16 spans the AABB's largest half-extent on every axis: a per-axis scale would shear
+    // the normals of anything that transforms them with the model matrix
+    const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    const glm::vec3 half   = (bounds.max - bounds.min) * 0.5f;
+    float           extent = std::max({half.x, half.y, half.z});
+    extent                 = extent > 0.0f ? extent : 1.0f;
+    if (std::ranges::find(packings, Packing::Position) != packings.end())
+      out.decode = {.scale = glm::vec3(halfPositions ? 1.0f : extent), .offset = center};
+
+    std::span<std::byte> vertices = arena.allocate<std::byte>(vertexCount * stride);
+    std::ranges::fill(vertices, std::byte{0});
+    for (size_t v = 0; v < vertexCount; ++v) {
+      const std::byte* src = mesh.vertices.data() + v * inStride;
+      std::byte*       dst = vertices.data() + v * stride;
+      for (size_t a = 0; a < attributes.size(); ++a) {
+        const VertexAttribute& in = mesh.attributes[a];
+        std::byte*             at = dst + attributes[a].offset;
+        float                  c[4]{};
+        if (packings[a] != Packing::Copy)
+          std::memcpy(c, src + in.offset, in.size * sizeof(float));
+
+        switch (packings[a]) {
+          case Packing::Position: {
+            const glm::vec3 p = glm::vec3(c[0], c[1], c[2]) - center;
+            if (halfPositions)
+              store(at, {glm::packHalf1x16(p.x), glm::packHalf1x16(p.y), glm::packHalf1x16(p.z)});
+            else {
+              const glm::vec3 q = p / extent;
+              store(at, {snorm16(q.x), snorm16(q.y), snorm16(q.z)});
+            }
+            break;
+          }
+          case Packing::Direction: {
+            const glm::vec2 e = octEncode({c[0], c[1], c[2]});
+            if (in.size == 4)
+              store(at, {snorm16(e.x), snorm16(e.y), snorm16(c[3] < 0.0f ? -1.0f : 1.0f)});
+            else
+              store(at, {snorm16(e.x), snorm16(e.y)});
+            break;
+          }
+          case Packing::Uv:
+            store(at, {glm::packHalf1x16(c[0]), glm::packHalf1x16(c[1])});
+            break;
+          case Packing::Copy:
+            std::memcpy(at, src + in.offset, in.size * componentSize(in.type));
+            break;
+        }
+      }
+    }
+    out.vertices   = vertices;
+    out.attributes = attributes;
+
+    if (shortIndices && vertexCount <= size_t{UINT16_MAX} + 1) {
+      std::span<uint16_t> narrow = arena.allocate<uint16_t>(mesh.indices.size() / sizeof(GLuint));
+      for (size_t i = 0; i < narrow.size(); ++i) {
+        GLuint index;
+        std::memcpy(&index, mesh.indices.data() + i * sizeof(index), sizeof(index));
+        narrow[i] = static_cast<uint16_t>(index);
+      }
+      out.indices   = std::as_bytes(narrow);
+      out.indexType = GL_UNSIGNED_SHORT;
+    } else
+      out.indices = mesh.indices;
+    return out;
+  }
+
+private:
+  enum class Packing : uint8_t { Position, Direction, Uv, Copy };
+
+  static uint16_t snorm16(float x) {
+    return static_cast<uint16_t>(
+        static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f)));
+  }
+
+  static void store(std::byte* at, std::initializer_list<uint16_t> components) {
+    std::memcpy(at, components.begin(), components.size() * sizeof(uint16_t));
+  }
+
+  // Octahedral map of a direction onto [-1, 1]^2: project onto the L1 unit sphere and fold the
+  // lower hemisphere over the diagonals. Zero vectors map to +Z.
+  static glm::vec2 octEncode(glm::vec3 n) {
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0f)
+      return glm::vec2(0.0f);
+    n /= l1;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+      e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+          glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return e;
+  }
+};
+
+// ---- meshlets ----
+// Splits a mesh into clusters of at most maxVertices vertices and maxTriangles triangles, each a
+// contiguous range of its index buffer, and bounds every cluster with a sphere and a normal cone
+// so RenderPass::clusterCulling can skip the ones that are off-screen or entirely back-facing.
+// GL 4.3 has no mesh shaders: a surviving meshlet is one more indirect command over its range.
+// Clusters grow greedily from a seed triangle by the neighbour that adds the fewest vertices,
+// ties going to the normal closest to the cluster's. Run it after MeshOptimizer, whose triangle
+// order seeds the growth, and before VertexEncoder, which passes the meshlets through:
+//
+//   std::vector<Meshlet> meshlets = MeshletBuilder{}.build(data); // reorders data.indices
+//   MeshView             view     = data.view();
+//   view.meshlets                 = meshlets;
+
+struct MeshletBuilder {
+  uint32_t maxVertices  = 64;
+  uint32_t maxTriangles = 124;
+  float    coneWeight   = 0.25f; // 0 grows by shared vertices alone; more keeps the cones narrow
+
+  // Reorders the triangles of `mesh` so every meshlet is contiguous; vertices are not touched.
+  // Needs float positions at location 0.
+  std::vector<Meshlet> build(MeshData& mesh) const {
+    ASSERT_ALWAYS(mesh.indices.size() % 3 == 0 && maxVertices >= 3 && maxTriangles > 0);
+    auto position = std::ranges::find(mesh.attributes, GLuint{0}, &VertexAttribute::location);
+    ASSERT_ALWAYS(position != mesh.attributes.end() && position->type == GL_FLOAT &&
+                  position->size >= 3 && "meshlets need float positions at location 0");
+
+    const size_t stride      = vertexStride(mesh.attributes);
+    const size_t vertexCount = mesh.vertices.size() / stride;
+    const size_t triangles   = mesh.indices.size() / 3;
+    auto         read        = [&](GLuint v) {
+      glm::vec3 p;
+      std::memcpy(&p, mesh.vertices.data() + position->offset + size_t(v) * stride, sizeof(p));
+      return p;
+    };
+    auto corner = [&](size_t t, int k) { return mesh.indices[t * 3 + k]; };
+
+    std::vector<glm::vec3> normals(triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+      const glm::vec3 a = read(corner(t, 0));
+      const glm::vec3 n = glm::cross(read(corner(t, 1)) - a, read(corner(t, 2)) - a);
+      const float     l = glm::length(n);
+      normals[t]        = l > 0.0f ? n / l : glm::vec3(0.0f);
+    }
+
+    // triangles around each vertex; emitted ones are swapped out of the first live[v] entries
+    std::vector<uint32_t> offsets(vertexCount + 1, 0), live(vertexCount, 0);
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    for (GLuint index : mesh.indices) {
+      ASSERT_ALWAYS(index < vertexCount && "index past the end of the vertex stream");
+      ++offsets[index + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    for (size_t t = 0; t < triangles; ++t)
+      for (int k = 0; k < 3; ++k)
+        adjacency[offsets[corner(t, k)] + live[corner(t, k)]++] = static_cast<uint32_t>(t);
+
+    std::vector<uint8_t>  emitted(triangles, 0);
+    std::vector<uint32_t> owner(vertexCount, UINT32_MAX); // meshlet that already holds a vertex
+    std::vector<GLuint>   order;
+    std::vector<GLuint>   vertices; // of the open meshlet
+    std::vector<Meshlet>  meshlets;
+    order.reserve(mesh.indices.size());
+
+    glm::vec3 normalSum{0.0f};
+    uint32_t  open   = 0, openTriangles = 0;
+    size_t    cursor = 0;
+
+    auto added = [&](size_t t) {
+      uint32_t n = 0;
+      for (int k = 0; k < 3; ++k)
+        n += owner[corner(t, k)] != open;
+      return n;
+    };
+    auto close = [&] {
+      if (openTriangles)
+        meshlets.push_back(bound(order, order.size() - openTriangles * 3, vertices, read));
+      vertices.clear();
+      normalSum     = glm::vec3(0.0f);
+      openTriangles = 0;
+      ++open;
+    };
+    auto emit = [&](size_t t) {
+      emitted[t] = 1;
+      for (int k = 0; k < 3; ++k) {
+        const GLuint v = corner(t, k);
+        if (owner[v] != open) {
+          owner[v] = open;
+          vertices.push_back(v);
+        }
+        order.push_back(v);
+
+        uint32_t* first = adjacency.data() + offsets[v];
+        std::swap(*std::find(first, first + live[v], uint32_t(t)), first[--live[v]]);
+      }
+      normalSum += normals[t];
+      ++openTriangles;
+    };
+
+    for (size_t done = 0; done < triangles; ++done) {
+      const float     length = glm::length(normalSum);
+      const glm::vec3 axis   = length > 0.0f ? normalSum / length : glm::vec3(0.0f);
+
+      size_t best      = SIZE_MAX;
+      float  bestScore = std::numeric_limits<float>::infinity();
+      for (GLuint v : vertices) {
+        for (uint32_t a = offsets[v]; a < offsets[v] + live[v]; ++a) {
+          const uint32_t t = adjacency[a];
+          const uint32_t n = added(t);
+          if (vertices.size() + n > maxVertices)
+            continue;
+          const float score = float(n) + coneWeight * (1.0f - glm::dot(normals[t], axis));
+          if (score < bestScore) {
+            best      = t;
+            bestScore = score;
+          }
+        }
+      }
+
+      // nothing adjacent fits: start over from the next triangle in index order, keeping it in
+      // the open meshlet only while that is still mostly empty
+      if (best == SIZE_MAX) {
+        while (emitted[cursor])
+          ++cursor;
+        best = cursor;
+        if (openTriangles * 4 >= maxTriangles || vertices.size() + added(best) > maxVertices)
+          close();
+      }
+
+      emit(best);
+      if (openTriangles == maxTriangles)
+        close();
+    }
+    close();
+
+    std::ranges::copy(order, mesh.indices.begin());
+    return meshlets;
+  }
+
+private:
+  // Sphere around the AABB center of `vertices` and the normal cone of the triangles of
+  // order[first, end). The cone cutoff is the sine of the normals' spread, which turns the
+  // back-facing test into one cone-versus-sphere comparison (see backFacing); spreads wider
+  // than about 84 degrees never cull.
+  template <typename Read>
+  static Meshlet bound(std::span<const GLuint> order,
+                       size_t                  first,
+                       std::span<const GLuint> vertices,
+                       Read                    read) {
+    glm::vec3 lo = read(vertices[0]), hi = lo;
+    for (GLuint v : vertices) {
+      lo = glm::min(lo, read(v));
+      hi = glm::max(hi, read(v));
+    }
+    const glm::vec3 center  = (lo + hi) * 0.5f;
+    float           radius2 = 0.0f;
+    for (GLuint v : vertices)
+      radius2 = std::max(radius2, glm::dot(read(v) - center, read(v) - center));
+
+    std::vector<glm::vec3> normals;
+    glm::vec3              sum{0.0f};
+    for (size_t i = first; i < order.size(); i += 3) {
+      const glm::vec3 a = read(order[i]);
+      const glm::vec3 n = glm::cross(read(order[i + 1]) - a, read(order[i + 2]) - a);
+      const float     l = glm::length(n);
+      if (l > 0.0f) {
+        normals.push_back(n / l);
+        sum += n / l;
+      }
+    }
+
+    Meshlet meshlet{.sphere     = glm::vec4(center, std::sqrt(radius2)),
+                    .firstIndex = static_cast<uint32_t>(first),
+                    .indexCount = static_cast<uint32_t>(order.size() - first)};
+    const float length = glm::length(sum);
+    if (length == 0.0f)
+      return meshlet;
+
+    const glm::vec3 axis   = sum / length;
+    float           minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+      minDot = std::min(minDot, glm::dot(n, axis));
+    if (minDot > 0.1f)
+      meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    return meshlet;
+  }
+};
+
+// Whether every triangle of `meshlet` faces away from `eye` (both in object space): the eye lies
+// outside the cone, widened by the cone cutoff, around the meshlet's sphere.
+inline bool backFacing(const Meshlet& meshlet, const glm::vec3& eye) {
+  const glm::vec3 d = glm::vec3(meshlet.sphere) - eye;
+  return meshlet.cone.w < 1.0f &&
+         glm::dot(d, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(d) + meshlet.sphere.w;
+}
+
+// Whether drawing with `raster` under `transform` discards the triangles that face away from
+// their object-space normals, i.e. whether backFacing meshlets may be skipped. A mirroring
+// transform flips the winding the rasterizer sees.
+inline bool culledBackFaces(const RasterState& raster, const glm::mat4& transform) {
+  const bool mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+  return raster.cullFace == GL_BACK && (raster.frontFace == GL_CCW) != mirrored;
+}
+
+// ---- level of detail ----
+// Import-time LOD chains. MeshSimplifier collapses edges in order of their quadric error
+// (Garland and Heckbert 1997). Each vertex that survives a collapse stays where it was, so every
+// coarser level is just another index range over the same vertex buffer. A level's error is
+// the largest distance any collapse behind it moved the surface (the root mean square over the
+// merged planes), in object space. RenderPass draws the coarsest level whose error projects to
+// at most lodThreshold pixels. Vertices on open borders, and seams where several vertices share
+// a position, never move, so levels neither open holes nor tear attributes apart. Build the
+// meshlets first: MeshletBuilder reorders the indices the first level copies.
+//
+//   MeshLods lods = MeshSimplifier{}.build(data); // or run(meshes).meshes[i], in parallel
+//   MeshView view = data.view();
+//   view.indices  = std::as_bytes(std::span(lods.indices));
+//   view.lods     = lods.levels;
+
+struct MeshLods {
+  std::vector<GLuint>  indices; // the mesh's own indices, then each coarser level's
+  std::vector<MeshLod> levels;  // levels[0] is the full mesh
+};
+
+struct MeshSimplifyReport {
+  std::vector<MeshLods> meshes;                // in input order
+  size_t                levels            = 0; // coarser levels over all meshes
+  size_t                triangles         = 0; // of the full meshes
+  size_t                coarsestTriangles = 0; // of each mesh's coarsest level
+  double                totalMs           = 0;
+};
+
+struct MeshSimplifier {
+  uint32_t maxLevels = 4;    // coarser levels after the full mesh
+  float    ratio     = 0.5f; // each level aims for this fraction of the previous one's triangles
+  float    maxError  = 0.1f; // no collapse may move the surface further, relative to the radius
+  size_t   threads   = 0;    // run(): 0 is one per core
+
+  // Needs float positions at location 0. The chain ends early once a level cannot shed at least
+  // a tenth of the triangles of the one before it within maxError.
+  MeshLods build(const MeshData& mesh) const {
+    ASSERT_ALWAYS(mesh.indices.size() % 3 == 0 && ratio > 0.0f && ratio < 1.0f);
+    auto position = std::ranges::find(mesh.attributes, GLuint{0}, &VertexAttribute::location);
+    ASSERT_ALWAYS(position != mesh.attributes.end() && position->type == GL_FLOAT &&
+                  position->size >= 3 && "simplification needs float positions at location 0");
+
+    MeshLods lods;
+    lods.indices.assign(mesh.indices.begin(), mesh.indices.end());
+    lods.levels.push_back({.indexCount = static_cast<uint32_t>(mesh.indices.size())});
+
+    const size_t           stride      = vertexStride(mesh.attributes);
+    const size_t           vertexCount = mesh.vertices.size() / stride;
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+      std::memcpy(&positions[v], mesh.vertices.data() + position->offset + v * stride, 12);
+    for (GLuint index : mesh.indices)
+      ASSERT_ALWAYS(index < vertexCount && "index past the end of the vertex stream");
+    if (mesh.indices.empty())
+      return lods;
+
+    // one canonical vertex per position; seams are positions shared by several vertices
+    std::vector<GLuint>  canonical(vertexCount), byPosition(vertexCount);
+    std::vector<uint8_t> locked(vertexCount, 0); // kBorder | kSeam
+    std::iota(byPosition.begin(), byPosition.end(), GLuint{0});
+    auto key = [&](GLuint v) { return std::tie(positions[v].x, positions[v].y, positions[v].z); };
+    std::ranges::sort(byPosition, [&](GLuint a, GLuint b) { return key(a) < key(b); });
+    for (size_t i = 0; i < vertexCount; ++i) {
+      const bool same = i > 0 && key(byPosition[i]) == key(byPosition[i - 1]);
+      canonical[byPosition[i]] = same ? canonical[byPosition[i - 1]] : byPosition[i];
+      if (same)
+        locked[canonical[byPosition[i]]] = locked[byPosition[i]] = kSeam;
+    }
+
+    // corners as canonical vertices; `corners` keeps the original index for the output
+    std::vector<GLuint> corners(mesh.indices.begin(), mesh.indices.end());
+    std::vector<GLuint> triangles(corners.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+      triangles[i] = canonical[corners[i]];
+    lockBorders(triangles, locked);
+
+    std::vector<Quadric> quadrics(vertexCount);
+    glm::vec3            lo = positions[triangles[0]], hi = lo;
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+      const glm::vec3 a = positions[triangles[t]], b = positions[triangles[t + 1]],
+                      c = positions[triangles[t + 2]];
+      const Quadric   q = Quadric::plane(a, b, c);
+      for (int k = 0; k < 3; ++k) {
+        quadrics[triangles[t + k]] += q;
+        lo = glm::min(lo, positions[triangles[t + k]]);
+        hi = glm::max(hi, positions[triangles[t + k]]);
+      }
+    }
+    const double limit = double(maxError) * 0.5 * double(glm::length(hi - lo));
+
+    std::vector<GLuint> collapsed(vertexCount);
+    std::iota(collapsed.begin(), collapsed.end(), GLuint{0});
+    double error = 0.0;
+
+    for (uint32_t level = 1; level <= maxLevels; ++level) {
+      const size_t before = triangles.size() / 3;
+      const size_t target = static_cast<size_t>(double(before) * double(ratio));
+      while (triangles.size() / 3 > target) {
+        double     passError = 0.0;
+        const bool progress  = collapsePass(
+            triangles, positions, locked, quadrics, collapsed, target, limit, passError);
+        error = std::max(error, passError);
+
+        // drop the triangles the collapses turned into lines or points
+        size_t out = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+          GLuint v[3];
+          for (int k = 0; k < 3; ++k)
+            v[k] = collapsed[triangles[t + k]];
+          if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+            continue;
+          for (int k = 0; k < 3; ++k) {
+            triangles[out + k] = v[k];
+            corners[out + k]   = v[k] == canonical[corners[t + k]] ? corners[t + k] : v[k];
+          }
+          out += 3;
+        }
+        triangles.resize(out);
+        corners.resize(out);
+        if (!progress)
+          break;
+      }
+
+      if (triangles.empty() || triangles.size() / 3 * 10 > before * 9)
+        break;
+      lods.levels.push_back({.firstIndex = static_cast<uint32_t>(lods.indices.size()),
+                             .indexCount = static_cast<uint32_t>(corners.size()),
+                             .error      = static_cast<float>(error)});
+      lods.indices.insert(lods.indices.end(), corners.begin(), corners.end());
+    }
+    return lods;
+  }
+
+  // Simplifies every mesh in parallel, see runEach.
+  MeshSimplifyReport run(std::span<const MeshData> meshes) const {
+    const auto         start = Clock::now();
+    MeshSimplifyReport report;
+    report.meshes.resize(meshes.size());
+    runEach(meshes.size(), threads, [&](size_t i) { report.meshes[i] = build(meshes[i]); });
+
+    for (const MeshLods& mesh : report.meshes) {
+      report.levels += mesh.levels.size() - 1;
+      report.triangles += mesh.levels.front().indexCount / 3;
+      report.coarsestTriangles += mesh.levels.back().indexCount / 3;
+    }
+    report.totalMs = elapsedMs(start);
+    return report;
+  }
+
+private:
+  static constexpr uint8_t kBorder = 1;
+  static constexpr uint8_t kSeam   = 2;
+
+  // Sum of area-weighted squared distances to a set of planes, as the symmetric 4x4 matrix
+  // (xx xy xz xw yy yz yw zz zw ww) over homogeneous points.
+  struct Quadric {
+    std::array<double, 10> m{};
+    double                 weight = 0.0;
+
+    static Quadric plane(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+      const glm::dvec3 n    = glm::cross(glm::dvec3(b - a), glm::dvec3(c - a));
+      const double     area = glm::length(n); // twice the area
+      if (area == 0.0)
+        return {};
+      const glm::dvec3 u = n / area;
+      const double     d = -glm::dot(u, glm::dvec3(a));
+      const double     w = area * 0.5;
+      return {.m      = {w * u.x * u.x,
+                         w * u.x * u.y,
+                         w * u.x * u.z,
+                         w * u.x * d,
+                         w * u.y * u.y,
+                         w * u.y * u.z,
+                         w * u.y * d,
+                         w * u.z * u.z,
+                         w * u.z * d,
+                         w * d * d},
+              .weight = w};
+    }
+
+    Quadric& operator+=(const Quadric& o) {
+      for (size_t i = 0; i < m.size(); ++i)
+        m[i] += o.m[i];
+      weight += o.weight;
+      return *this;
+    }
+
+    // Mean squared distance of `p` to the planes.
+    double error(const glm::vec3& p) const {
+      if (weight == 0.0)
+        return 0.0;
+      const double x = p.x, y = p.y, z = p.z;
+      const double e = m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x +
+                       m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y + m[7] * z * z +
+                       2 * m[8] * z + m[9];
+      return std::max(e, 0.0) / weight;
+    }
+  };
+
+  // Locks the vertices of edges with one triangle (open borders) or more than two.
+  static void lockBorders(std::span<const GLuint> triangles, std::vector<uint8_t>& locked) {
+    std::vector<uint64_t> edges;
+    edges.reserve(triangles.size());
+    for (size_t t = 0; t < triangles.size(); t += 3)
+      for (int k = 0; k < 3; ++k) {
+        const GLuint a = triangles[t + k], b = triangles[t + (k + 1) % 3];
+        edges.push_back(uint64_t{std::min(a, b)} << 32 | std::max(a, b));
+      }
+    std::ranges::sort(edges);
+    for (size_t i = 0, j; i < edges.size(); i = j) {
+      for (j = i + 1; j < edges.size() && edges[j] == edges[i];)
+        ++j;
+      if (j - i != 2) {
+        locked[edges[i] >> 32] |= kBorder;
+        locked[edges[i] & UINT32_MAX] |= kBorder;
+      }
+    }
+  }
+
+  // One round of collapses, cheapest first, each vertex involved in at most one so the flip
+  // tests stay exact. Records collapses in `collapsed` and the largest error in `maxError`.
+  // Returns whether anything collapsed.
+  static bool collapsePass(std::span<const GLuint>    triangles,
+                           std::span<const glm::vec3> positions,
+                           std::span<const uint8_t>   locked,
+                           std::vector<Quadric>&      quadrics,
+                           std::vector<GLuint>&       collapsed,
+                           size_t                     target,
+                           double                     limit,
+                           double&                    maxError) {
+    const size_t vertexCount = positions.size();
+
+    // triangles around each vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0), adjacency(triangles.size());
+    for (GLuint v : triangles)
+      ++offsets[v + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangles.size(); ++i)
+      adjacency[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+
+    // u collapses into v: u moves, so it must be free; v keeps its place and must not be a seam
+    struct Collapse {
+      double cost;
+      GLuint u, v;
+    };
+    std::vector<Collapse> candidates;
+    for (size_t t = 0; t < triangles.size(); t += 3)
+      for (int k = 0; k < 3; ++k) {
+        const GLuint a = triangles[t + k], b = triangles[t + (k + 1) % 3];
+        for (auto [u, v] : {std::pair{a, b}, std::pair{b, a}}) {
+          if (locked[u] || (locked[v] & kSeam) || u == v)
+            continue;
+          Quadric q = quadrics[u];
+          q += quadrics[v];
+          const double cost = q.error(positions[v]);
+          if (cost <= limit * limit)
+            candidates.push_back({cost, u, v});
+        }
+      }
+    std::ranges::sort(candidates, {}, &Collapse::cost);
+
+    // each collapse removes about two triangles; stop near the target rather than overshoot
+    const size_t budget = (triangles.size() / 3 - target + 1) / 2;
+    std::vector<uint8_t> touched(vertexCount, 0);
+    size_t               done = 0;
+    for (const Collapse& c : candidates) {
+      if (done >= budget)
+        break;
+      if (touched[c.u] || touched[c.v] || flips(c.u, c.v, triangles, positions, offsets, adjacency))
+        continue;
+
+      collapsed[c.u] = c.v;
+      quadrics[c.v] += quadrics[c.u];
+      maxError = std::max(maxError, std::sqrt(c.cost));
+      for (GLuint w : {c.u, c.v})
+        for (uint32_t a = offsets[w]; a < offsets[w + 1]; ++a)
+          for (int k = 0; k < 3; ++k)
+            touched[triangles[adjacency[a] * 3 + k]] = 1;
+      ++done;
+    }
+    return done > 0;
+  }
+
+  // Whether moving u onto v turns any remaining triangle around u over.
+  static bool flips(GLuint                     u,
+                    GLuint                     v,
+                    std::span<const GLuint>    triangles,
+                    std::span<const glm::vec3> positions,
+                    std::span<const uint32_t>  offsets,
+                    std::span<const uint32_t>  adjacency) {
+    for (uint32_t a = offsets[u]; a < offsets[u + 1]; ++a) {
+      const GLuint* t = &triangles[adjacency[a] * 3];
+      if (t[0] == v || t[1] == v || t[2] == v)
+        continue; // collapses away
+
+      glm::vec3 p[3], q[3];
+      for (int k = 0; k < 3; ++k) {
+        p[k] = positions[t[k]];
+        q[k] = t[k] == u ? positions[v] : p[k];
+      }
+      const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+      const glm::vec3 after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+      if (glm::dot(before, after) <= 0.0f)
+        return true;
+    }
+    return false;
+  }
+};
+
+// Coarsest level whose error, scaled to world space by `scale` and seen from `distance`, covers
+// at most `threshold` pixels. `pixelsPerUnit` is the projected size of a unit at distance 1,
+// the viewport height over 2 tan(fov / 2).
+inline uint32_t selectLod(std::span<const MeshLod> lods,
+                          float                    scale,
+                          float                    distance,
+                          float                    pixelsPerUnit,
+                          float                    threshold) {
+  uint32_t level = 0;
+  while (level + 1 < lods.size() &&
+         lods[level + 1].error * scale * pixelsPerUnit <= threshold * distance)
+    ++level;
+  return level;
+}
+
+using ShaderSource = std::variant<FileSource, StringSource, EmbeddedSource>;
+
+struct ShaderSpec {
+  ShaderStage  stage;
+  ShaderSource source;
+};
+
+using ShaderPipeline = std::vector<ShaderSpec>;
+
+constexpr GLenum toGLenum(ShaderStage stage) {
+  switch (stage) {
+    case ShaderStage::Vertex:
+      return GL_VERTEX_SHADER;
+    case ShaderStage::Fragment:
+      return GL_FRAGMENT_SHADER;
+    case ShaderStage::Geometry:
+      return GL_GEOMETRY_SHADER;
+    case ShaderStage::Compute:
+      return GL_COMPUTE_SHADER;
+    case ShaderStage::TessControl:
+      return GL_TESS_CONTROL_SHADER;
+    case ShaderStage::TessEval:
+      return GL_TESS_EVALUATION_SHADER;
+  }
+  throw std::logic_error("Unhandled ShaderStage");
+}
+
+inline std::string readFile(const std::string& path) {
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Failed to open shader file: " + path);
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+inline GLuint compileShader(GLenum type, const std::string& source) {
+  GLuint      shader = glCreateShader(type);
+  const char* src    = source.c_str();
+
+  glShaderSource(shader, 1, &src, nullptr);
+  glCompileShader(shader);
+
+  GLint ok = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+  if (!ok) {
+    GLint len = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+
+    std::string log(len, '\0');
+    glGetShaderInfoLog(shader, len, nullptr, log.data());
+
+    glDeleteShader(shader);
+    throw std::runtime_error("Shader compile error:\n" + log);
+  }
+
+  return shader;
+}
+struct ShaderModule {
+  GLuint      id = 0;
+  ShaderStage stage;
+
+  ShaderModule(GLuint id, ShaderStage stage) : id(id), stage(stage) {}
+
+  ShaderModule(const ShaderModule&)            = delete;
+  ShaderModule& operator=(const ShaderModule&) = delete;
+
+  ShaderModule(ShaderModule&& other) noexcept : id(other.id), stage(other.stage) { other.id = 0; }
+
+  ~ShaderModule() {
+    if (id)
+      glDeleteShader(id);
+  }
+};
+
+template <typename>
+inline constexpr bool always_false = false;
+struct ShaderLoader {
+  // The GLSL text behind a source, reading files as needed.
+  static std::string resolve(const ShaderSource& source) {
+    return std::visit(
+        [](auto&& src) -> std::string {
+          using T = std::decay_t<decltype(src)>;
+
+          if constexpr (std::is_same_v<T, FileSource>)
+            return readFile(src.path);
+
+          else if constexpr (std::is_same_v<T, StringSource>)
+            return src.code;
+
+          else if constexpr (std::is_same_v<T, EmbeddedSource>)
+            return src.code;
+
+          else
+            static_assert(always_false<T>, "Unhandled ShaderSource");
+        },
+        source);
+  }
+
+  static ShaderModule load(ShaderStage stage, const std::string& code) {
+    return ShaderModule{compileShader(toGLenum(stage), code), stage};
+  }
+
+  static ShaderModule load(ShaderStage stage, const ShaderSource& source) {
+    return load(stage, resolve(source));
+  }
+};
+
+// ---- block layout ----
+// C++ structs shared with GLSL uniform (std140) and storage (std430) blocks. A struct is described
+// once by specializing BlockDescription with its GLSL name and fields:
+//
+//   struct LightBlock {
+//     glm::vec3 position;
+//     float     radius;
+//     glm::vec4 color;
+//   };
+//   template <> struct BlockDescription<LightBlock> {
+//     static constexpr const char* name   = "Light";
+//     static constexpr auto        fields = std::tuple{BLOCK_FIELD(LightBlock, position, "pos"),
+//                                                     BLOCK_FIELD(LightBlock, radius, "radius"),
+//                                                     BLOCK_FIELD(LightBlock, color, "color")};
+//   };
+//
+// blockLayout<T>() computes the offsets GL assigns to the fields at compile time, and
+// static_assert(blockMatches<T>(BlockLayout::Std140)) proves the C++ struct already has them, so
+// the struct is uploaded as is. glslBlock<T>() writes the matching declaration; ProgramPipe::block
+// injects it into a program. Fields are float, int32_t and uint32_t scalars, glm vectors and
+// matrices of those, std::arrays and C arrays, and other described structs. A vec3 followed by a
+// scalar packs like GLSL; glm::mat3 and scalar arrays under std140 do not and fail the check.
+enum class BlockLayout : uint8_t { Std140, Std430 };
+
+template <typename T>
+struct BlockDescription; // specialize with `name` and `fields`
+
+template <typename T>
+struct BlockField {
+  using Type = T;
+
+  const char* name;   // in GLSL
+  size_t      offset; // in the C++ struct
+};
+
+#define BLOCK_FIELD(Struct, member, glslName)                                                      \
+  BlockField<std::remove_cvref_t<decltype(Struct::member)>> { glslName, offsetof(Struct, member) }
+
+template <typename T>
+concept DescribedBlock = requires {
+  BlockDescription<T>::name;
+  BlockDescription<T>::fields;
+};
+
+template <typename T>
+struct GlslScalar : std::false_type {};
+template <>
+struct GlslScalar<float> : std::true_type {
+  static constexpr const char* prefix = "";
+  static constexpr const char* name   = "float";
+};
+template <>
+struct GlslScalar<int32_t> : std::true_type {
+  static constexpr const char* prefix = "i";
+  static constexpr const char* name   = "int";
+};
+template <>
+struct GlslScalar<uint32_t> : std::true_type {
+  static constexpr const char* prefix = "u";
+  static constexpr const char* name   = "uint";
+};
+
+template <typename T>
+struct GlslVector : std::false_type {};
+template <glm::length_t L, typename S, glm::qualifier Q>
+struct GlslVector<glm::vec<L, S, Q>> : std::true_type {
+  using Scalar                   = S;
+  static constexpr size_t length = L;
+};
+
+template <typename T>
+struct GlslMatrix : std::false_type {};
+template <glm::length_t C, glm::length_t R, typename S, glm::qualifier Q>
+struct GlslMatrix<glm::mat<C, R, S, Q>> : std::true_type {
+  using Column                    = glm::vec<R, S, Q>;
+  static constexpr size_t columns = C;
+  static constexpr size_t rows    = R;
+};
+
+// Base alignment and size of one member under a layout.
+struct BlockMember {
+  size_t align;
+  size_t size;
+};
+
+// Offset and size of every field of T, and of T as a whole (size includes the tail padding).
+template <size_t N>
+struct BlockOffsets {
+  std::array<size_t, N> offsets{};
+  std::array<size_t, N> sizes{};
+  size_t                align = 0;
+  size_t                size  = 0;
+};
+
+constexpr size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+constexpr auto blockLayout(BlockLayout layout);
+
+template <typename T>
+struct BlockArray : std::false_type {};
+template <typename E, size_t N>
+struct BlockArray<std::array<E, N>> : std::true_type {
+  using Element                 = E;
+  static constexpr size_t count = N;
+};
+template <typename E, size_t N>
+struct BlockArray<E[N]> : std::true_type {
+  using Element                 = E;
+  static constexpr size_t count = N;
+};
+
+template <typename T>
+constexpr BlockMember blockMember(BlockLayout layout) {
+  if constexpr (GlslScalar<T>::value) {
+    return {4, 4};
+  } else if constexpr (GlslVector<T>::value) {
+    static_assert(GlslScalar<typename GlslVector<T>::Scalar>::value, "unsupported vector type");
+    const size_t n = GlslVector<T>::length;
+    return {n == 3 ? 16 : 4 * n, 4 * n};
+  } else if constexpr (GlslMatrix<T>::value) {
+    // a matrix is an array of column vectors
+    static_assert(std::is_same_v<typename GlslMatrix<T>::Column::value_type, float>,
+                  "unsupported matrix type");
+    return blockMember<std::array<typename GlslMatrix<T>::Column, GlslMatrix<T>::columns>>(layout);
+  } else if constexpr (BlockArray<T>::value) {
+    const BlockMember element = blockMember<typename BlockArray<T>::Element>(layout);
+    size_t            align   = element.align;
+    if (layout == BlockLayout::Std140)
+      align = alignUp(align, 16);
+    return {align, BlockArray<T>::count * alignUp(element.size, align)};
+  } else {
+    static_assert(DescribedBlock<T>, "not a GLSL type; describe it with BlockDescription");
+    const auto nested = blockLayout<T>(layout);
+    return {nested.align, nested.size};
+  }
+}
+
+template <typename T>
+constexpr auto blockLayout(BlockLayout layout) {
+  return std::apply(
+      [layout](const auto&... fields) {
+        BlockOffsets<sizeof...(fields)> result;
+        size_t                          end = 0, i = 0;
+        result.align                        = layout == BlockLayout::Std140 ? 16 : 4;
+
+        auto place = [&](const auto& field) {
+          using Field              = typename std::remove_cvref_t<decltype(field)>::Type;
+          const BlockMember member = blockMember<Field>(layout);
+          result.offsets[i]        = alignUp(end, member.align);
+          result.sizes[i]          = member.size;
+          result.align             = std::max(result.align, member.align);
+          end                      = result.offsets[i++] + member.size;
+        };
+        (place(fields), ...);
+
+        result.size = alignUp(end, result.align);
+        return result;
+      },
+      BlockDescription<T>::fields);
+}
+
+// True when every field of T, down through nested structs, sits at the offset and has the size
+// `layout` gives it, and T is as large as the block, so a T can be copied straight into the buffer.
+template <typename T>
+constexpr bool blockMatches(BlockLayout layout) {
+  const auto gl = blockLayout<T>(layout);
+  return std::apply(
+      [&](const auto&... fields) {
+        size_t i     = 0;
+        bool   match = sizeof(T) == gl.size;
+        auto   check = [&](const auto& field) {
+          using Field = typename std::remove_cvref_t<decltype(field)>::Type;
+          match &= field.offset == gl.offsets[i] && sizeof(Field) == gl.sizes[i];
+          if constexpr (DescribedBlock<Field>) {
+            match &= blockMatches<Field>(layout);
+          } else if constexpr (BlockArray<Field>::value) {
+            if constexpr (DescribedBlock<typename BlockArray<Field>::Element>)
+              match &= blockMatches<typename BlockArray<Field>::Element>(layout);
+          }
+          ++i;
+        };
+        (check(fields), ...);
+        return match;
+      },
+      BlockDescription<T>::fields);
+}
+
+// GLSL type of a field and the array suffix that goes after its name.
+template <typename T>
+std::string glslTypeName(std::string& suffix) {
+  if constexpr (GlslScalar<T>::value) {
+    return GlslScalar<T>::name;
+  } else if constexpr (BlockArray<T>::value) {
+    suffix = std::format("[{}]", BlockArray<T>::count) + suffix;
+    return glslTypeName<typename BlockArray<T>::Element>(suffix);
+  } else if constexpr (GlslMatrix<T>::value) {
+    constexpr size_t columns = GlslMatrix<T>::columns, rows = GlslMatrix<T>::rows;
+    return columns == rows ? std::format("mat{}", columns)
+                           : std::format("mat{}x{}", columns, rows);
+  } else if constexpr (GlslVector<T>::value) {
+    return std::format(
+        "{}vec{}", GlslScalar<typename GlslVector<T>::Scalar>::prefix, GlslVector<T>::length);
+  } else {
+    return BlockDescription<T>::name;
+  }
+}
+
+// Member declarations of T, one per line.
+template <typename T>
+std::string glslFields() {
+  std::string out;
+  std::apply(
+      [&](const auto&... fields) {
+        auto declare = [&](const auto& field) {
+          using Field        = typename std::remove_cvref_t<decltype(field)>::Type;
+          std::string suffix;
+          std::string type = glslTypeName<Field>(suffix);
+          out += std::format("  {} {}{};\n", type, field.name, suffix);
+        };
+        (declare(fields), ...);
+      },
+      BlockDescription<T>::fields);
+  return out;
+}
+
+// Declares the GLSL structs T depends on, innermost first and each once.
+template <typename T>
+void glslStructs(std::string& out, std::vector<std::string_view>& declared) {
+  if constexpr (BlockArray<T>::value) {
+    glslStructs<typename BlockArray<T>::Element>(out, declared);
+  } else if constexpr (DescribedBlock<T>) {
+    std::apply(
+        [&](const auto&... fields) {
+          (glslStructs<typename std::remove_cvref_t<decltype(fields)>::Type>(out, declared), ...);
+        },
+        BlockDescription<T>::fields);
+
+    const std::string_view name = BlockDescription<T>::name;
+    if (std::ranges::find(declared, name) != declared.end())
+      return;
+    declared.push_back(name);
+    out += std::format("struct {} {{\n{}}};\n", name, glslFields<T>());
+  }
+}
+
+// The declaration of T as `layout(std140, binding = N) uniform Name { ... };` or, for std430,
+// as a buffer block, preceded by the structs it uses.
+template <typename T>
+std::string glslBlock(GLuint binding, BlockLayout layout = BlockLayout::Std140) {
+  std::string                   out;
+  std::vector<std::string_view> declared;
+  std::apply(
+      [&](const auto&... fields) {
+        (glslStructs<typename std::remove_cvref_t<decltype(fields)>::Type>(out, declared), ...);
+      },
+      BlockDescription<T>::fields);
+
+  const bool std140 = layout == BlockLayout::Std140;
+  out += std::format("layout({}, binding = {}) {} {} {{\n{}}};\n",
+                     std140 ? "std140" : "std430",
+                     binding,
+                     std140 ? "uniform" : "buffer",
+                     BlockDescription<T>::name,
+                     glslFields<T>());
+  return out;
+}
+
+// ---- shader preprocessing ----
+// Runs between ShaderLoader::resolve and compilation. Expands #include (relative to the
+// including file, then the pipe's include dirs; each file at most once), injects the pipe's
+// defines after #version and its block declarations before the first line of code, and drops
+// #if branches whose outcome is already known, so each permutation reaches the driver as only
+// the code it compiles. Conditions the preprocessor
+// cannot decide, such as driver macros (GL_*, __*), function-like macros or macros defined
+// inside an undecided branch, stay in the text for the driver. #line directives keep compile
+// errors pointing at the original lines; source string N is the Nth file read.
+struct ShaderDefine {
+  std::string name;
+  std::string value;
+};
+
+struct ShaderPreprocessor {
+  std::span<const ShaderDefine> defines;
+  std::string_view              declarations; // GLSL placed before the first line of code
+  std::span<const std::string>  includeDirs;
+  std::vector<std::string>*     dependencies = nullptr; // files read, absolute and normalized
+
+  // `origin` is the file `code` came from, empty for embedded sources.
+  std::string run(std::string_view code, const std::filesystem::path& origin = {}) {
+    out.clear();
+    macros.clear();
+    unknown.clear();
+    included.clear();
+    branches.clear();
+    sources  = 0;
+    injected = false;
+    declared = declarations.empty();
+    resync   = false;
+    for (const ShaderDefine& define : defines)
+      macros[define.name] = define.value;
+
+    std::string file;
+    if (!origin.empty()) {
+      file = std::filesystem::absolute(origin).lexically_normal().string();
+      note(file);
+    }
+    process(code, file, 0);
+
+    if (!branches.empty())
+      throw std::runtime_error("Shader preprocessing: unterminated #if in " +
+                               (file.empty() ? std::string("embedded source") : file));
+    if (!injected && (!defines.empty() || !declared))
+      out.insert(0, header() + std::string(declarations) + "#line 1 0\n");
+    return std::move(out);
+  }
+
+  std::string header() const {
+    std::string text;
+    for (const ShaderDefine& define : defines)
+      text += std::format("#define {} {}\n", define.name, define.value);
+    return text;
+  }
+
+  // ---- state of one run ----
+  // State of one #if group. Inactive: no branch taken yet; Done: an earlier branch was taken;
+  // Undecided: passed through to the driver; Skipped: nested in a dropped branch.
+  enum class Branch : uint8_t { Active, Inactive, Done, Undecided, Skipped };
+
+  std::string                                  out;
+  std::unordered_map<std::string, std::string> macros;
+  std::vector<std::string>                     unknown; // defined or undefined in Undecided code
+  std::vector<std::string>                     included;
+  std::vector<Branch>                          branches;
+  int                                          sources  = 0;
+  bool                                         injected = false;
+  bool                                         declared = false; // declarations emitted
+  bool                                         resync   = false; // lines were dropped, emit #line
+
+  bool live() const {
+    return std::ranges::all_of(
+        branches, [](Branch b) { return b == Branch::Active || b == Branch::Undecided; });
+  }
+
+  bool undecided() const {
+    return std::ranges::find(branches, Branch::Undecided) != branches.end();
+  }
+
+  void note(const std::string& file) {
+    included.push_back(file);
+    if (dependencies && std::ranges::find(*dependencies, file) == dependencies->end())
+      dependencies->push_back(file);
+  }
+
+  void emit(std::string_view text, int line, int source) {
+    if (resync) {
+      out += std::format("#line {} {}\n", line, source);
+      resync = false;
+    }
+    out += text;
+    out += '\n';
+  }
+
+  static std::string_view trim(std::string_view s) {
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+      return {};
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+  }
+
+  static bool identifierChar(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+  }
+
+  // Tracks /* */ across lines: returns whether a block comment is still open after `line`.
+  static bool scanComments(std::string_view line, bool inComment) {
+    for (size_t i = 0; i + 1 < line.size(); ++i) {
+      if (inComment && line[i] == '*' && line[i + 1] == '/')
+        inComment = false, ++i;
+      else if (!inComment && line[i] == '/' && line[i + 1] == '/')
+        break;
+      else if (!inComment && line[i] == '/' && line[i + 1] == '*')
+        inComment = true, ++i;
+    }
+    return inComment;
+  }
+
+  static std::string stripComments(std::string_view s) {
+    std::string result;
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s.substr(i).starts_with("//"))
+        break;
+      if (s.substr(i).starts_with("/*")) {
+        const size_t close = s.find("*/", i + 2);
+        if (close == std::string_view::npos)
+          break;
+        result += ' ';
+        i = close + 1;
+        continue;
+      }
+      result += s[i];
+    }
+    return std::string(trim(result));
+  }
+
+  void process(std::string_view code, const std::string& file, int source) {
+    bool inComment = false;
+    for (int line = 1; !code.empty(); ++line) {
+      const size_t     eol  = code.find('\n');
+      std::string_view text = code.substr(0, eol);
+      code.remove_prefix(eol == std::string_view::npos ? code.size() : eol + 1);
+
+      const bool       commented = inComment;
+      std::string_view trimmed   = trim(text);
+      inComment                  = scanComments(text, inComment);
+
+      if (commented || !trimmed.starts_with('#')) {
+        if (!live()) {
+          resync = true;
+          continue;
+        }
+        // after #version and any #extension, outside of branches left to the driver
+        if (!declared && injected && !commented && !trimmed.empty() &&
+            !trimmed.starts_with("//") &&
+            std::ranges::all_of(branches, [](Branch b) { return b == Branch::Active; })) {
+          out += declarations;
+          declared = true;
+          resync   = true;
+        }
+        emit(text, line, source);
+        continue;
+      }
+      directive(trimmed.substr(1), text, file, line, source);
+    }
+  }
+
+  void directive(std::string_view body, std::string_view text, const std::string& file, int line,
+                 int source) {
+    body = trim(body);
+
+    const size_t      end  = std::ranges::find_if_not(body, identifierChar) - body.begin();
+    std::string_view  name = body.substr(0, end);
+    const std::string rest = stripComments(body.substr(end));
+
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+      if (!live()) {
+        branches.push_back(Branch::Skipped);
+        resync = true;
+        return;
+      }
+
+      std::optional<bool> taken;
+      if (!undecided())
+        taken = name == "if"      ? evaluate(rest)
+                : name == "ifdef" ? isDefined(rest)
+                                  : negate(isDefined(rest));
+      if (!taken) {
+        branches.push_back(Branch::Undecided);
+        emit(text, line, source);
+        return;
+      }
+      branches.push_back(*taken ? Branch::Active : Branch::Inactive);
+      resync = true;
+      return;
+    }
+
+    if (name == "elif" || name == "else" || name == "endif") {
+      if (branches.empty())
+        throw std::runtime_error(std::format("Shader preprocessing: stray #{} at {}:{}",
+                                             name,
+                                             file.empty() ? "embedded source" : file,
+                                             line));
+      Branch& branch = branches.back();
+      if (name == "endif") {
+        const bool passed = branch == Branch::Undecided;
+        branches.pop_back();
+        if (passed) {
+          emit(text, line, source);
+          return;
+        }
+      } else if (branch == Branch::Undecided) {
+        emit(text, line, source);
+        return;
+      } else if (branch == Branch::Active) {
+        branch = Branch::Done;
+      } else if (branch == Branch::Inactive) {
+        std::optional<bool> taken = name == "else" ? std::optional(true) : evaluate(rest);
+        if (!taken) {
+          // the dropped branches before it were false, so this one opens the group for the driver
+          branch = Branch::Undecided;
+          emit("#if " + rest, line, source);
+          return;
+        }
+        branch = *taken ? Branch::Active : Branch::Inactive;
+      }
+      resync = true;
+      return;
+    }
+
+    if (!live()) {
+      resync = true;
+      return;
+    }
+
+    if (name == "include") {
+      include(rest, file, line);
+      return;
+    }
+
+    if (name == "define" || name == "undef") {
+      const size_t      length = std::ranges::find_if_not(rest, identifierChar) - rest.begin();
+      const std::string macro  = rest.substr(0, length);
+
+      const bool functionLike = length < rest.size() && rest[length] == '(';
+
+      if (undecided() || functionLike) {
+        macros.erase(macro);
+        if (std::ranges::find(unknown, macro) == unknown.end())
+          unknown.push_back(macro);
+      } else if (name == "define") {
+        macros[macro] = std::string(trim(std::string_view(rest).substr(length)));
+      } else {
+        macros.erase(macro);
+      }
+      emit(text, line, source);
+      return;
+    }
+
+    if (name == "pragma" && rest == "once") {
+      resync = true; // every file is included once anyway
+      return;
+    }
+
+    emit(text, line, source);
+    if (name == "version" && source == 0 && !injected) {
+      injected = true;
+      out += header();
+      resync = !defines.empty();
+    }
+  }
+
+  void include(const std::string& rest, const std::string& file, int line) {
+    const char   close = rest.starts_with('<') ? '>' : '"';
+    const size_t end   = rest.find(close, 1);
+    if (rest.size() < 2 || (rest[0] != '"' && rest[0] != '<') || end == std::string::npos)
+      throw std::runtime_error(std::format("Shader preprocessing: malformed #include at {}:{}",
+                                           file.empty() ? "embedded source" : file,
+                                           line));
+    const std::string name = rest.substr(1, end - 1);
+
+    std::vector<std::filesystem::path> candidates;
+    if (!file.empty())
+      candidates.push_back(std::filesystem::path(file).parent_path() / name);
+    for (const std::string& dir : includeDirs)
+      candidates.push_back(std::filesystem::path(dir) / name);
+
+    for (const std::filesystem::path& candidate : candidates) {
+      if (!std::filesystem::is_regular_file(candidate))
+        continue;
+      std::string path = std::filesystem::absolute(candidate).lexically_normal().string();
+      if (std::ranges::find(included, path) == included.end()) {
+        note(path);
+        resync = true; // the included file's first line opens with its own #line
+        process(readFile(path), path, ++sources);
+      }
+      resync = true;
+      return;
+    }
+    throw std::runtime_error(std::format("Shader include \"{}\" not found (from {}:{})",
+                                         name,
+                                         file.empty() ? "embedded source" : file,
+                                         line));
+  }
+
+  static std::optional<bool> negate(std::optional<bool> value) {
+    return value ? std::optional(!*value) : std::nullopt;
+  }
+
+  // Macros the driver or undecided code may define are unknowable here.
+  bool knowable(std::string_view macro) const {
+    return !macro.starts_with("GL_") && !macro.starts_with("__") &&
+           std::ranges::find(unknown, macro) == unknown.end();
+  }
+
+  std::optional<bool> isDefined(std::string_view macro) const {
+    macro = trim(macro);
+    if (!knowable(macro))
+      return std::nullopt;
+    return macros.contains(std::string(macro));
+  }
+
+  std::optional<bool> evaluate(std::string_view expression) const {
+    Expression             parser{*this, expression};
+    std::optional<int64_t> value = parser.parse();
+    return value ? std::optional(*value != 0) : std::nullopt;
+  }
+
+  // #if constant expressions: integers, macros, defined, unary ! - + ~ and the C binary
+  // operators without ?:. nullopt means "cannot decide", including on malformed input.
+  struct Expression {
+    const ShaderPreprocessor& pp;
+    std::string_view          s;
+    int                       depth = 0;
+    size_t                    pos   = 0;
+    bool                      error = false;
+
+    std::optional<int64_t> parse() {
+      std::optional<int64_t> value = binary(1);
+      skipSpace();
+      return error || pos != s.size() ? std::nullopt : value;
+    }
+
+    void skipSpace() {
+      while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t'))
+        ++pos;
+    }
+
+    static int precedence(std::string_view op) {
+      static constexpr std::pair<std::string_view, int> table[] = {
+          {"||", 1}, {"&&", 2}, {"|", 3},  {"^", 4},  {"&", 5},  {"==", 6}, {"!=", 6},
+          {"<=", 7}, {">=", 7}, {"<<", 8}, {">>", 8}, {"<", 7},  {">", 7},  {"+", 9},
+          {"-", 9},  {"*", 10}, {"/", 10}, {"%", 10}};
+      for (const auto& [name, level] : table)
+        if (name == op)
+          return level;
+      return 0;
+    }
+
+    std::string_view peekOperator() {
+      skipSpace();
+      for (size_t length : {2, 1}) {
+        std::string_view op = s.substr(pos, length);
+        if (op.size() == length && precedence(op))
+          return op;
+      }
+      return {};
+    }
+
+    std::optional<int64_t> binary(int minPrecedence) {
+      std::optional<int64_t> lhs = unary();
+      for (std::string_view op = peekOperator(); !op.empty() && precedence(op) >= minPrecedence;
+           op                  = peekOperator()) {
+        pos += op.size();
+        lhs = apply(op, lhs, binary(precedence(op) + 1));
+      }
+      return lhs;
+    }
+
+    static std::optional<int64_t> apply(std::string_view        op,
+                                        std::optional<int64_t> a,
+                                        std::optional<int64_t> b) {
+      // one known side can settle a logical operator on its own
+      if (op == "&&")
+        return (a && !*a) || (b && !*b) ? std::optional<int64_t>(0)
+               : a && b                 ? std::optional<int64_t>(1)
+                                        : std::nullopt;
+      if (op == "||")
+        return (a && *a) || (b && *b) ? std::optional<int64_t>(1)
+               : a && b               ? std::optional<int64_t>(0)
+                                      : std::nullopt;
+      if (!a || !b || ((op == "/" || op == "%") && *b == 0))
+        return std::nullopt;
+
+      const int64_t x = *a;
+      const int64_t y = *b;
+      if (op == "|")
+        return x | y;
+      if (op == "^")
+        return x ^ y;
+      if (op == "&")
+        return x & y;
+      if (op == "==")
+        return x == y;
+      if (op == "!=")
+        return x != y;
+      if (op == "<")
+        return x < y;
+      if (op == ">")
+        return x > y;
+      if (op == "<=")
+        return x <= y;
+      if (op == ">=")
+        return x >= y;
+      if (op == "<<")
+        return x << (y & 63);
+      if (op == ">>")
+        return x >> (y & 63);
+      if (op == "+")
+        return x + y;
+      if (op == "-")
+        return x - y;
+      if (op == "*")
+        return x * y;
+      if (op == "/")
+        return x / y;
+      return x % y;
+    }
+
+    std::optional<int64_t> unary() {
+      skipSpace();
+      if (pos >= s.size()) {
+        error = true;
+        return std::nullopt;
+      }
+      const char c = s[pos];
+      if (c == '!' || c == '-' || c == '+' || c == '~') {
+        ++pos;
+        std::optional<int64_t> v = unary();
+        if (!v)
+          return v;
+        return c == '!' ? int64_t(!*v) : c == '-' ? -*v : c == '~' ? ~*v : *v;
+      }
+      if (c == '(') {
+        ++pos;
+        std::optional<int64_t> v = binary(1);
+        skipSpace();
+        if (pos >= s.size() || s[pos] != ')')
+          error = true;
+        ++pos;
+        return v;
+      }
+      if (c >= '0' && c <= '9') {
+        const char* begin = s.data() + pos;
+        char*       end   = nullptr;
+        int64_t     v     = std::strtoll(begin, &end, 0);
+        pos += end - begin;
+        while (pos < s.size() && (s[pos] == 'u' || s[pos] == 'U'))
+          ++pos;
+        return v;
+      }
+      if (!identifierChar(c)) {
+        error = true;
+        return std::nullopt;
+      }
+
+      const size_t     begin = pos;
+      while (pos < s.size() && identifierChar(s[pos]))
+        ++pos;
+      std::string_view name = s.substr(begin, pos - begin);
+
+      if (name == "defined") {
+        skipSpace();
+        const bool paren = pos < s.size() && s[pos] == '(';
+        pos += paren;
+        skipSpace();
+        const size_t start = pos;
+        while (pos < s.size() && identifierChar(s[pos]))
+          ++pos;
+        std::optional<bool> known = pp.isDefined(s.substr(start, pos - start));
+        skipSpace();
+        if (paren && (pos >= s.size() || s[pos++] != ')'))
+          error = true;
+        return known ? std::optional<int64_t>(*known) : std::nullopt;
+      }
+
+      skipSpace();
+      if (!pp.knowable(name) || (pos < s.size() && s[pos] == '('))
+        return std::nullopt; // may be a function-like macro: nothing after it is parsed reliably
+      auto macro = pp.macros.find(std::string(name));
+      if (macro == pp.macros.end())
+        return 0; // undefined identifiers are 0, as in C
+      if (macro->second.empty() || depth > 16)
+        return std::nullopt;
+      return Expression{pp, macro->second, depth + 1}.parse();
+    }
+  };
+};
+
+// ---- program binary cache ----
+// Linked program binaries (glGetProgramBinary) kept in one file next to the executable's data.
+// Entries are keyed by a hash of every stage's resolved source; the file header records the
+// driver (GL_RENDERER + GL_VERSION) that produced them and a cache from another driver is
+// ignored. Existing entries are read straight out of a read-only mapping of the file; new ones
+// are held in memory until save() rewrites the file.
+//
+// File layout, native endianness:
+//   ProgramCacheHeader
+//   ProgramCacheEntry[count]
+//   binaries, at the offsets recorded in the entries
+struct ProgramCacheHeader {
+  static constexpr uint32_t kMagic   = 0x31435054; // "TPC1"
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic   = kMagic;
+  uint32_t version = kVersion;
+  uint64_t driver  = 0;
+  uint64_t count   = 0;
+};
+
+struct ProgramCacheEntry {
+  uint64_t key;
+  uint64_t offset;
+  uint32_t format;
+  uint32_t size;
+};
+static_assert(sizeof(ProgramCacheHeader) == 24 && sizeof(ProgramCacheEntry) == 24);
+
+struct ProgramCacheStats {
+  uint32_t hits     = 0; // programs loaded with glProgramBinary
+  uint32_t misses   = 0; // programs compiled from source
+  uint32_t rejected = 0; // binaries the driver refused; recompiled and replaced
+  uint32_t stored   = 0; // binaries added since the cache was opened
+};
+
+struct ProgramCache {
+  struct Binary {
+    GLenum                     format = 0;
+    std::span<const std::byte> bytes; // into the mapping, or into `owned`
+    std::vector<std::byte>     owned;
+  };
+
+  std::string                          path;
+  uint64_t                             driver  = 0;
+  bool                                 enabled = false; // driver exposes binary formats
+  bool                                 dirty   = false;
+  MappedFile                           file;
+  std::unordered_map<uint64_t, Binary> binaries;
+  ProgramCacheStats                    stats;
+
+  ProgramCache() = default;
+
+  ProgramCache(const ProgramCache&)            = delete;
+  ProgramCache& operator=(const ProgramCache&) = delete;
+
+  // Needs a current GL context; reads GL_RENDERER / GL_VERSION.
+  explicit ProgramCache(std::string cachePath) : path(std::move(cachePath)) {
+    auto glString = [](GLenum name) {
+      const GLubyte* s = glGetString(name);
+      return s ? std::string_view(reinterpret_cast<const char*>(s)) : std::string_view{};
+    };
+    driver = fnv1a64(glString(GL_VERSION), fnv1a64(glString(GL_RENDERER)));
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    enabled = formats > 0;
+    if (!enabled) {
+      LOG_WARN("ProgramCache: driver exposes no program binary formats, cache disabled");
+      return;
+    }
+
+    ProgramCacheHeader header;
+    if (!file.open(path) || file.size < sizeof(header))
+      return;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.magic != ProgramCacheHeader::kMagic ||
+        header.version != ProgramCacheHeader::kVersion || header.driver != driver ||
+        header.count > (file.size - sizeof(header)) / sizeof(ProgramCacheEntry)) {
+      LOGF_INFO("ProgramCache: ignoring stale cache {}", path);
+      return;
+    }
+
+    for (uint64_t i = 0; i < header.count; ++i) {
+      ProgramCacheEntry entry;
+      std::memcpy(
+          &entry, file.data + sizeof(header) + i * sizeof(ProgramCacheEntry), sizeof(entry));
+      if (entry.offset > file.size || entry.size > file.size - entry.offset)
+        continue;
+      binaries[entry.key] = {.format = entry.format,
+                             .bytes  = {file.data + entry.offset, entry.size}};
+    }
+  }
+
+  ~ProgramCache() {
+    if (dirty)
+      save();
+  }
+
+  uint64_t key(std::span<const std::pair<ShaderStage, std::string>> stages) const {
+    uint64_t h = fnv1a64(std::to_string(driver));
+    for (const auto& [stage, code] : stages) {
+      h = fnv1a64(std::to_string(static_cast<int>(stage)), h);
+      h = fnv1a64(code, h);
+    }
+    return h;
+  }
+
+  // A linked program for `key`, or 0 when there is no usable binary.
+  GLuint load(uint64_t key) {
+    auto it = enabled ? binaries.find(key) : binaries.end();
+    if (it == binaries.end())
+      return 0;
+
+    const Binary& binary  = it->second;
+    GLuint        program = glCreateProgram();
+    glProgramBinary(program,
+                    binary.format,
+                    binary.bytes.data(),
+                    static_cast<GLsizei>(binary.bytes.size()));
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      glDeleteProgram(program);
+      binaries.erase(it);
+      dirty = true;
+      ++stats.rejected;
+      return 0;
+    }
+
+    ++stats.hits;
+    return program;
+  }
+
+  // Records the binary of a freshly linked program. The program should have been linked with
+  // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+  void store(uint64_t key, GLuint program) {
+    if (!enabled)
+      return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+      return;
+
+    Binary binary;
+    binary.owned.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binary.format, binary.owned.data());
+    binary.owned.resize(written);
+    binary.bytes = binary.owned;
+
+    binaries[key] = std::move(binary);
+    dirty         = true;
+    ++stats.stored;
+  }
+
+  // Rewrites the cache file through a temporary and a rename, so a crash never leaves a torn
+  // file behind. The current mapping stays valid; it refers to the replaced file.
+  bool save() {
+    if (!enabled || path.empty())
+      return false;
+
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!out) {
+        LOGF_WARN("ProgramCache: cannot write {}", tmp);
+        return false;
+      }
+
+      ProgramCacheHeader header;
+      header.driver = driver;
+      header.count  = binaries.size();
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      uint64_t offset = sizeof(header) + binaries.size() * sizeof(ProgramCacheEntry);
+      for (const auto& [key, binary] : binaries) {
+        ProgramCacheEntry entry{.key    = key,
+                                .offset = offset,
+                                .format = binary.format,
+                                .size   = static_cast<uint32_t>(binary.bytes.size())};
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        offset += binary.bytes.size();
+      }
+      for (const auto& [key, binary] : binaries)
+        out.write(reinterpret_cast<const char*>(binary.bytes.data()), binary.bytes.size());
+
+      if (!out) {
+        LOGF_WARN("ProgramCache: failed writing {}", tmp);
+        return false;
+      }
+    }
+
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      LOGF_WARN("ProgramCache: cannot replace {}", path);
+      return false;
+    }
+    dirty = false;
+    return true;
+  }
+};
+// Scans the context's extension list; callers cache the answer.
+inline bool glExtensionSupported(std::string_view extension) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (name && extension == name)
+      return true;
+  }
+  return false;
+}
+
+// GL_KHR_parallel_shader_compile (or the ARB original): compiles and links run on driver
+// threads and GL_COMPLETION_STATUS_KHR can be polled. Without it, Program::poll blocks on the
+// first query like a synchronous build would.
+inline bool parallelShaderCompile() {
+  static const bool supported = [] {
+    if (!glExtensionSupported("GL_KHR_parallel_shader_compile") &&
+        !glExtensionSupported("GL_ARB_parallel_shader_compile"))
+      return false;
+    if (glMaxShaderCompilerThreadsKHR)
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu); // let the driver pick
+    return true;
+  }();
+  return supported;
+}
+
+inline std::string shaderInfoLog(GLuint shader) {
+  GLint len = 0;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+  std::string log(std::max(len, 1), '\0');
+  glGetShaderInfoLog(shader, len, nullptr, log.data());
+  return log;
+}
+
+inline LinkStatus Program::poll() {
+  if (!pending)
+    return status;
+
+  if (parallelShaderCompile()) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done)
+      return status;
+  }
+
+  std::unique_ptr<PendingLink> link = std::move(pending);
+  defer(for (GLuint shader : link->shaders) glDeleteShader(shader));
+
+  GLint linked = 0;
+  glGetProgramiv(id, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    std::string log;
+    for (GLuint shader : link->shaders) {
+      GLint compiled = 0;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if (!compiled)
+        log += shaderInfoLog(shader);
+    }
+    if (log.empty()) {
+      GLint len = 0;
+      glGetProgramiv(id, GL_INFO_LOG_LENGTH, &len);
+      log.assign(std::max(len, 1), '\0');
+      glGetProgramInfoLog(id, len, nullptr, log.data());
+    }
+    LOGF_ERROR("Async program build failed:\n{}", log);
+    status = LinkStatus::Failed;
+    return status;
+  }
+
+  if (link->cache)
+    link->cache->store(link->key, id);
+  reflect();
+  status = LinkStatus::Ready;
+  return status;
+}
+
+struct ProgramPipe {
+  ShaderPipeline            pipeline;
+  std::vector<ShaderDefine> defines;      // sorted by name
+  std::string               declarations; // injected after the defines, see block()
+  std::vector<std::string>  includeDirs;  // searched after the including file's directory
+  ProgramCache*             programCache = nullptr;
+
+  ProgramPipe add(ShaderStage stage, ShaderSource source) const {
+    ProgramPipe next = *this;
+    next.pipeline.push_back({stage, std::move(source)});
+    return next;
+  }
+
+  // `#define name value` in every stage; redefining a name replaces its value.
+  ProgramPipe define(std::string name, std::string value = "1") const {
+    ProgramPipe next = *this;
+    auto        it   = std::ranges::lower_bound(next.defines, name, {}, &ShaderDefine::name);
+    if (it != next.defines.end() && it->name == name)
+      it->value = std::move(value);
+    else
+      next.defines.insert(it, {std::move(name), std::move(value)});
+    return next;
+  }
+
+  // Declares the described struct T (see BlockDescription) as a uniform block, or a buffer block
+  // for std430, at `binding` in every stage, so the shader cannot disagree with the C++ layout.
+  template <typename T, BlockLayout Layout = BlockLayout::Std140>
+  ProgramPipe block(GLuint binding) const {
+    static_assert(blockMatches<T>(Layout), "C++ struct does not match its GLSL block layout");
+    ProgramPipe next = *this;
+    next.declarations += glslBlock<T>(binding, Layout);
+    return next;
+  }
+
+  ProgramPipe includeDir(std::string dir) const {
+    ProgramPipe next = *this;
+    next.includeDirs.push_back(std::move(dir));
+    return next;
+  }
+
+  // Every stage's preprocessed source. Files read on the way, stage files and includes, are
+  // appended to `dependencies` when given.
+  std::vector<std::pair<ShaderStage, std::string>> sources(
+      std::vector<std::string>* dependencies = nullptr) const {
+    ShaderPreprocessor preprocessor{.defines      = defines,
+                                    .declarations = declarations,
+                                    .includeDirs  = includeDirs,
+                                    .dependencies = dependencies};
+
+    std::vector<std::pair<ShaderStage, std::string>> stages;
+    stages.reserve(pipeline.size());
+    for (const auto& spec : pipeline) {
+      const auto* file = std::get_if<FileSource>(&spec.source);
+      stages.emplace_back(
+          spec.stage,
+          preprocessor.run(ShaderLoader::resolve(spec.source),
+                           file ? std::filesystem::path(file->path) : std::filesystem::path{}));
+    }
+    return stages;
+  }
+
+  // Look the program up in `cache` before compiling, and store it there after linking.
+  ProgramPipe cache(ProgramCache& target) const {
+    ProgramPipe next  = *this;
+    next.programCache = &target;
+    return next;
+  }
+
+  // Compiles and links preprocessed stages into a GL program, throwing on any error. Touches no
+  // tessera state, so it may run on another thread that has a shared context current.
+  static GLuint link(const std::vector<std::pair<ShaderStage, std::string>>& stages,
+                     bool                                                    retrievable) {
+    GLuint                    program = glCreateProgram();
+    std::vector<ShaderModule> shaders; // deleted on return, the program keeps them alive
+    shaders.reserve(stages.size());
+
+    try {
+      for (const auto& [stage, code] : stages) {
+        shaders.push_back(ShaderLoader::load(stage, code));
+        glAttachShader(program, shaders.back().id);
+      }
+    } catch (...) {
+      glDeleteProgram(program);
+      throw;
+    }
+
+    if (retrievable)
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+      GLint len = 0;
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+      std::string log(len, '\0');
+      glGetProgramInfoLog(program, len, nullptr, log.data());
+
+      glDeleteProgram(program);
+      throw std::runtime_error("Program link error:\n" + log);
+    }
+    return program;
+  }
+
+  Program build() const {
+    if (pipeline.empty())
+      throw std::runtime_error("ProgramPipe: empty pipeline");
+
+    std::vector<std::pair<ShaderStage, std::string>> stages = sources();
+
+    uint64_t key = 0;
+    if (programCache) {
+      key = programCache->key(stages);
+      if (GLuint cached = programCache->load(key)) {
+        Program result{cached};
+        result.reflect();
+        return result;
+      }
+      ++programCache->stats.misses;
+    }
+
+    GLuint program = link(stages, programCache != nullptr);
+    if (programCache)
+      programCache->store(key, program);
+
+    Program result{program}; // RAII object
+    result.reflect();
+    return result;
+  }
+
+  // Submits every compile and the link without waiting for any of them. The returned program is
+  // Pending (unless it came from the cache) and finishes through Program::poll; draw it through
+  // a Material with a fallback meanwhile. Errors surface as LinkStatus::Failed, not exceptions.
+  Program buildAsync() const {
+    if (pipeline.empty())
+      throw std::runtime_error("ProgramPipe: empty pipeline");
+
+    std::vector<std::pair<ShaderStage, std::string>> stages = sources();
+
+    auto link = std::make_unique<PendingLink>();
+    if (programCache) {
+      link->cache = programCache;
+      link->key   = programCache->key(stages);
+      if (GLuint cached = programCache->load(link->key)) {
+        Program result{cached};
+        result.reflect();
+        return result;
+      }
+      ++programCache->stats.misses;
+    }
+
+    parallelShaderCompile(); // raises the driver's compiler thread count on first use
+
+    GLuint program = glCreateProgram();
+    for (const auto& [stage, code] : stages) {
+      GLuint      shader = glCreateShader(toGLenum(stage));
+      const char* src    = code.c_str();
+      glShaderSource(shader, 1, &src, nullptr);
+      glCompileShader(shader);
+      glAttachShader(program, shader);
+      link->shaders.push_back(shader);
+    }
+
+    if (programCache)
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    Program result{program};
+    result.status  = LinkStatus::Pending;
+    result.pending = std::move(link);
+    return result;
+  }
+};
+
+// ---- program permutations ----
+// Programs keyed by (source hash, define hash). Every variant of an uber-shader is requested
+// through get() with its own define set; the same permutation is compiled once and shared by
+// all the Materials that ask for it. File stages are identified by path, so a hot-reloaded
+// file keeps its permutations.
+struct PermutationKey {
+  uint64_t source  = 0;
+  uint64_t defines = 0;
+
+  bool operator==(const PermutationKey&) const = default;
+};
+
+struct PermutationKeyHash {
+  size_t operator()(const PermutationKey& k) const {
+    return static_cast<size_t>(k.source ^ (k.defines * 0x9E3779B97F4A7C15ull));
+  }
+};
+
+struct PermutationCacheStats {
+  uint32_t hits   = 0; // requests answered with an existing program
+  uint32_t builds = 0; // permutations compiled
+};
+
+struct PermutationCache {
+  std::unordered_map<PermutationKey, std::unique_ptr<Program>, PermutationKeyHash> programs;
+  PermutationCacheStats                                                            stats;
+
+  static PermutationKey key(const ProgramPipe& pipe) {
+    PermutationKey k{.source = fnv1a64(""), .defines = fnv1a64("")};
+    for (const ShaderSpec& spec : pipe.pipeline) {
+      k.source = fnv1a64(std::to_string(static_cast<int>(spec.stage)), k.source);
+      k.source = std::visit(
+          [&](const auto& src) {
+            using T = std::decay_t<decltype(src)>;
+            if constexpr (std::is_same_v<T, FileSource>)
+              return fnv1a64(src.path, fnv1a64("file:", k.source));
+            else
+              return fnv1a64(src.code, fnv1a64("code:", k.source));
+          },
+          spec.source);
+    }
+    for (const std::string& dir : pipe.includeDirs)
+      k.source = fnv1a64(dir, fnv1a64("dir:", k.source));
+
+    // pipe.defines is kept sorted, so the order they were added in does not matter
+    for (const ShaderDefine& define : pipe.defines)
+      k.defines = fnv1a64(define.value, fnv1a64("=", fnv1a64(define.name, k.defines)));
+    k.defines = fnv1a64(pipe.declarations, k.defines);
+    return k;
+  }
+
+  // The program for `pipe`'s sources and defines, built with pipe.build() on first request.
+  // The reference stays valid for the cache's lifetime.
+  Program& get(const ProgramPipe& pipe) {
+    const PermutationKey k = key(pipe);
+    if (auto it = programs.find(k); it != programs.end()) {
+      ++stats.hits;
+      return *it->second;
+    }
+
+    auto program = std::make_unique<Program>(pipe.build());
+    ++stats.builds;
+    return *programs.emplace(k, std::move(program)).first->second;
+  }
+};
+
+// ---- shader hot reload ----
+// ShaderWatcher follows the files behind FileSource stages, and every file they #include, with
+// inotify. A background thread re-preprocesses programs whose files changed; update()
+// rebuilds them with ProgramPipe::buildAsync and, once the new program has linked, swaps it into
+// the watched Program with Program::replace. Nothing compiles or blocks inside a frame, and a
+// program that fails to build keeps running its previous version.
+
+// Watches are placed on directories rather than files, so editors that save through a rename
+// are seen too. Watched Programs must keep their address while the watcher lives. Hot reload is
+// Linux-only; elsewhere watch() declines and update() does nothing.
+struct ShaderWatcher {
+  static constexpr int kPollMs   = 100; // how often the thread checks for shutdown
+  static constexpr int kSettleMs = 30;  // quiet time after a change before sources are re-read
+
+  struct Watched {
+    Program*    program;
+    ProgramPipe pipe;
+    Program     candidate; // rebuild in flight; id 0 when idle
+  };
+
+  // Sources of a changed program, read on the watcher thread.
+  struct Reload {
+    size_t                                           index;
+    std::vector<std::pair<ShaderStage, std::string>> stages;
+  };
+
+  std::vector<Watched> watched; // GL thread only
+
+  std::mutex                                           mutex; // guards the members below
+  std::vector<ProgramPipe>                             pipes;      // per watched program
+  std::unordered_map<std::string, std::vector<size_t>> dependents; // file -> watched indices
+  std::unordered_map<int, std::string>                 directories; // inotify wd -> directory
+  std::vector<Reload>                                  reloads; // waiting for update()
+
+  int          fd = -1;
+  std::jthread thread;
+
+  ShaderWatcher() = default;
+
+  ShaderWatcher(const ShaderWatcher&)            = delete;
+  ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+  ~ShaderWatcher() {
+    if (thread.joinable()) {
+      thread.request_stop();
+      thread.join();
+    }
+#if defined(__linux__)
+    if (fd >= 0)
+      ::close(fd);
+#endif
+  }
+
+  // Reloads `program` from `pipe` whenever one of its files changes. Returns false when the
+  // pipeline has no FileSource stage or hot reload is unavailable.
+  bool watch(Program& program, const ProgramPipe& pipe) {
+    if (std::ranges::none_of(pipe.pipeline, [](const ShaderSpec& spec) {
+          return std::holds_alternative<FileSource>(spec.source);
+        }))
+      return false;
+
+    std::vector<std::string> files;
+    pipe.sources(&files);
+
+#if defined(__linux__)
+    if (fd < 0) {
+      fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (fd < 0) {
+        LOG_WARN("ShaderWatcher: inotify unavailable, hot reload disabled");
+        return false;
+      }
+      thread = std::jthread([this](std::stop_token stop) { run(stop); });
+    }
+
+    std::scoped_lock lock(mutex);
+    watched.push_back({.program = &program, .pipe = pipe, .candidate = {}});
+    pipes.push_back(pipe);
+    track(watched.size() - 1, files);
+    return true;
+#else
+    LOG_WARN("ShaderWatcher: hot reload needs inotify (Linux)");
+    return false;
+#endif
+  }
+
+  // Starts rebuilds for changed programs and swaps in the ones that finished linking. Call once
+  // per frame on the GL thread; returns how many programs were replaced. Materials using them
+  // stop being ready() until Material::poll re-resolves their uniforms.
+  size_t update() {
+    std::vector<Reload> changed;
+    {
+      std::scoped_lock lock(mutex);
+      changed.swap(reloads);
+    }
+
+    for (Reload& reload : changed) {
+      Watched&    w    = watched[reload.index];
+      ProgramPipe pipe = w.pipe;
+      pipe.pipeline.clear();
+      pipe.defines.clear(); // already applied by the preprocessor
+      pipe.declarations.clear();
+      for (auto& [stage, code] : reload.stages)
+        pipe.pipeline.push_back({stage, StringSource{std::move(code)}});
+      w.candidate = pipe.buildAsync(); // supersedes a rebuild still in flight
+    }
+
+    size_t replaced = 0;
+    for (Watched& w : watched) {
+      if (!w.candidate.id)
+        continue;
+
+      switch (w.candidate.poll()) {
+        case LinkStatus::Pending:
+          break;
+        case LinkStatus::Failed:
+          LOGF_WARN("ShaderWatcher: keeping the previous build of program {}", w.program->id);
+          w.candidate.destroy();
+          break;
+        case LinkStatus::Ready:
+          w.program->replace(std::move(w.candidate));
+          LOGF_INFO("ShaderWatcher: reloaded program {}", w.program->id);
+          ++replaced;
+          break;
+      }
+    }
+    return replaced;
+  }
+
+private:
+  // Re-reads the sources of `dirty` programs and queues them for update(). Runs on the thread.
+  void reload(std::span<const size_t> dirty) {
+    for (size_t index : dirty) {
+      ProgramPipe pipe;
+      {
+        std::scoped_lock lock(mutex);
+        pipe = pipes[index];
+      }
+
+      Reload                   reload{.index = index, .stages = {}};
+      std::vector<std::string> files;
+      try {
+        reload.stages = pipe.sources(&files);
+      } catch (const std::runtime_error& e) {
+        // typically a file caught mid-save; the write that completes it triggers another reload
+        LOGF_WARN("ShaderWatcher: {}", e.what());
+        continue;
+      }
+
+      std::scoped_lock lock(mutex);
+      track(index, files); // the edit may have added includes
+      reloads.push_back(std::move(reload));
+    }
+  }
+
+#if defined(__linux__)
+  // Registers `files` as dependencies of watched program `index`. Expects `mutex` held.
+  void track(size_t index, std::span<const std::string> files) {
+    for (const std::string& file : files) {
+      std::vector<size_t>& users = dependents[file];
+      if (std::ranges::find(users, index) == users.end())
+        users.push_back(index);
+
+      // re-adding a directory returns its existing watch descriptor
+      std::string directory = std::filesystem::path(file).parent_path().string();
+      int         wd =
+          inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+      if (wd >= 0)
+        directories[wd] = std::move(directory);
+    }
+  }
+
+  void run(std::stop_token stop) {
+    std::vector<size_t> dirty;
+    alignas(inotify_event) char buffer[4096];
+
+    while (!stop.stop_requested()) {
+      // editors save in bursts of events; wait until they settle before reading the files
+      pollfd  pfd{.fd = fd, .events = POLLIN, .revents = 0};
+      int     ready = ::poll(&pfd, 1, dirty.empty() ? kPollMs : kSettleMs);
+      ssize_t length;
+
+      if (ready == 0 && !dirty.empty()) {
+        reload(dirty);
+        dirty.clear();
+        continue;
+      }
+
+      while (ready > 0 && (length = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        std::scoped_lock lock(mutex);
+        for (char* at = buffer; at < buffer + length;) {
+          const auto* event = reinterpret_cast<const inotify_event*>(at);
+          at += sizeof(inotify_event) + event->len;
+
+          auto directory = directories.find(event->wd);
+          if (event->len == 0 || directory == directories.end())
+            continue;
+          auto file = dependents.find(
+              (std::filesystem::path(directory->second) / event->name).string());
+          if (file == dependents.end())
+            continue;
+
+          for (size_t index : file->second)
+            if (std::ranges::find(dirty, index) == dirty.end())
+              dirty.push_back(index);
+        }
+      }
+    }
+  }
+#else
+  void track(size_t, std::span<const std::string>) {}
+#endif
+};
+
+using UniformValue = std::variant<int, float, glm::vec4, glm::mat4>;
+
+// ---- pipeline state ----
+// A Program together with the fixed-function state it draws with. PipelineStates are interned
+// in gPipelineStates: equal (program, state) pairs resolve to the same immutable object, whose
+// dense id orders the draw sort key and lets GLState skip binds that change nothing. Entries
+// live as long as the cache; a Program replaced in place (hot reload) keeps its pipelines.
+struct PipelineState {
+  uint32_t       id;
+  const Program* program;
+  RenderState    state;
+
+  // Uses the program and writes the fields of `state` that differ from the pipeline bound last.
+  void bind() const {
+    program->use();
+    gGLState.bindRenderState(id, state);
+  }
+};
+
+struct PipelineKey {
+  const Program* program;
+  RenderState    state;
+
+  bool operator==(const PipelineKey&) const = default;
+};
+
+struct PipelineKeyHash {
+  size_t operator()(const PipelineKey& k) const {
+    const RenderState& state = k.state;
+    uint64_t           h     = fnv1a64("");
+    auto               mix   = [&h](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+
+    mix(reinterpret_cast<uintptr_t>(k.program));
+    mix(uint64_t(state.depth.func) << 2 | state.depth.write << 1 | state.depth.test);
+    mix(uint64_t(state.blend.srcColor) << 32 | state.blend.dstColor);
+    mix(uint64_t(state.blend.srcAlpha) << 32 | state.blend.dstAlpha);
+    mix(uint64_t(state.blend.colorOp) << 32 | state.blend.alphaOp);
+    mix(state.blend.colorMask << 1 | state.blend.enable);
+    mix(uint64_t(state.stencil.func) << 32 | uint32_t(state.stencil.ref));
+    mix(uint64_t(state.stencil.readMask) << 32 | state.stencil.writeMask);
+    mix(uint64_t(state.stencil.fail) << 32 | state.stencil.depthFail);
+    mix(uint64_t(state.stencil.pass) << 1 | state.stencil.enable);
+    mix(uint64_t(state.raster.cullFace) << 32 | state.raster.frontFace);
+    mix(uint64_t(std::bit_cast<uint32_t>(state.raster.offsetFactor)) << 32 |
+        std::bit_cast<uint32_t>(state.raster.offsetUnits));
+    mix(state.raster.polygonMode);
+    return static_cast<size_t>(h);
+  }
+};
+
+struct PipelineCacheStats {
+  uint32_t hits    = 0; // lookups answered with an existing pipeline
+  uint32_t created = 0;
+};
+
+struct PipelineCache {
+  std::unordered_map<PipelineKey, std::unique_ptr<PipelineState>, PipelineKeyHash> pipelines;
+  PipelineCacheStats                                                                stats;
+
+  const PipelineState& get(const Program& program, const RenderState& state) {
+    const PipelineKey key{.program = &program, .state = state};
+    if (auto it = pipelines.find(key); it != pipelines.end()) {
+      ++stats.hits;
+      return *it->second;
+    }
+
+    auto pipeline = std::make_unique<PipelineState>(PipelineState{
+        .id = static_cast<uint32_t>(pipelines.size()), .program = &program, .state = state});
+    ++stats.created;
+    return *pipelines.emplace(key, std::move(pipeline)).first->second;
+  }
+};
+
+inline PipelineCache gPipelineStates;
+
+struct TextureBinding {
+  GLuint texture;
+  GLenum target;
+  GLuint unit;
+};
+struct CachedUniform {
+  GLint        location = -1;      // default-block uniform, set with glUniform*
+  int32_t      offset   = -1;      // byte offset inside the material block
+  GLenum       type     = GL_NONE; // reflected type of the block member
+  UniformValue value;
+};
+
+// Materials whose program declares
+//   layout(std140, binding = 2) uniform Material { ... };
+// keep those parameters in a flat block compiled by resolveUniforms(). set() patches the block
+// and widens a dirty range; bind() uploads just that range and binds the whole block with a
+// single glBindBufferRange.
+constexpr GLuint      kMaterialBinding   = 2;
+constexpr const char* kMaterialBlockName = "Material";
+
+struct MaterialBlock {
+  GLuint                 buffer = 0;
+  std::vector<std::byte> data;
+  mutable size_t         dirtyBegin = 0;
+  mutable size_t         dirtyEnd   = 0;
+
+  MaterialBlock() = default;
+
+  MaterialBlock(const MaterialBlock&)            = delete;
+  MaterialBlock& operator=(const MaterialBlock&) = delete;
+
+  MaterialBlock(MaterialBlock&& other) noexcept { *this = std::move(other); }
+
+  MaterialBlock& operator=(MaterialBlock&& other) noexcept {
+    destroy();
+    buffer       = other.buffer;
+    data         = std::move(other.data);
+    dirtyBegin   = other.dirtyBegin;
+    dirtyEnd     = other.dirtyEnd;
+    other.buffer = 0;
+    return *this;
+  }
+
+  void allocate(size_t size) {
+    if (!buffer)
+      glGenBuffers(1, &buffer);
+    data.assign(size, std::byte{0});
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    dirtyBegin = 0;
+    dirtyEnd   = size;
+  }
+
+  // std140 puts every UniformValue alternative at its natural C++ layout (mat4: four vec4
+  // columns), so values are copied as-is into a member of the reflected `type`.
+  void write(size_t offset, GLenum type, const UniformValue& value) {
+    std::visit(
+        [&](const auto& v) {
+          ASSERT_ALWAYS(holds(type, v) && "material value does not match the block member type");
+          ASSERT_ALWAYS(offset + sizeof(v) <= data.size());
+          std::memcpy(data.data() + offset, &v, sizeof(v));
+          markDirty(offset, offset + sizeof(v));
+        },
+        value);
+  }
+
+  static bool holds(GLenum type, int) { return type == GL_INT || type == GL_BOOL; }
+  static bool holds(GLenum type, float) { return type == GL_FLOAT; }
+  static bool holds(GLenum type, const glm::vec4&) { return type == GL_FLOAT_VEC4; }
+  static bool holds(GLenum type, const glm::mat4&) { return type == GL_FLOAT_MAT4; }
+
+  void markDirty(size_t begin, size_t end) {
+    if (dirtyBegin == dirtyEnd) {
+      dirtyBegin = begin;
+      dirtyEnd   = end;
+      return;
+    }
+    dirtyBegin = std::min(dirtyBegin, begin);
+    dirtyEnd   = std::max(dirtyEnd, end);
+  }
+
+  void flush() const {
+    if (dirtyBegin == dirtyEnd)
+      return;
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, data.data() + dirtyBegin);
+    gGLState.countUpload(dirtyEnd - dirtyBegin);
+    dirtyBegin = dirtyEnd = 0;
+  }
+
+  void destroy() {
+    if (buffer) {
+      glDeleteBuffers(1, &buffer);
+      gGLState.forgetBuffer(buffer);
+    }
+    buffer = 0;
+    data.clear();
+  }
+
+  ~MaterialBlock() { destroy(); }
+};
+
+// Top field of the draw sort key. Opaque draws go first, front-to-back; transparent draws
+// follow, back-to-front.
+enum class RenderLayer : uint8_t { Opaque = 0, Transparent = 1 };
+
+inline uint32_t nextMaterialSortId() {
+  static uint32_t next = 0;
+  return next++;
+}
+
+struct Material {
+  Program*                                       program; // non-owning reference
+  std::unordered_map<std::string, CachedUniform> uniforms;
+  std::vector<TextureBinding>                    textures;
+  RenderLayer                                    layer  = RenderLayer::Opaque;
+  uint32_t                                       sortId = nextMaterialSortId();
+  RenderState                                    state; // fixed-function state, see setState
+
+  const PipelineState* pipeline = nullptr; // program + state, interned by resolveUniforms
+
+  MaterialBlock                     block;
+  std::vector<const CachedUniform*> loose; // default-block uniforms; map nodes never move
+
+  // Drawn in this material's place until its program has linked (see ProgramPipe::buildAsync).
+  const Material* fallback          = nullptr;
+  bool            deferred          = false; // resolveUniforms waits for the program
+  uint32_t        programGeneration = 0;     // Program::generation the uniforms were resolved for
+
+  bool ready() const {
+    return program && program->ready() && !deferred && programGeneration == program->generation;
+  }
+
+  // Polls a pending program and resolves the uniforms once it is ready, or again after the
+  // program was replaced (hot reload). Call from the render loop; returns ready().
+  bool poll() {
+    if (program && program->poll() == LinkStatus::Ready && !ready())
+      resolveUniforms();
+    return ready();
+  }
+
+  // Takes effect on the next bind; a material that is not resolved yet picks it up in
+  // resolveUniforms.
+  void setState(const RenderState& next) {
+    state = next;
+    if (ready())
+      pipeline = &gPipelineStates.get(*program, state);
+  }
+
+  void set(const std::string& name, UniformValue value) {
+    CachedUniform& u = uniforms[name];
+    u.value          = std::move(value);
+    if (u.offset >= 0)
+      block.write(u.offset, u.type, u.value);
+  }
+
+  void resolveUniforms() {
+    ASSERT_ALWAYS(program);
+
+    deferred = !program->ready();
+    if (deferred)
+      return;
+    programGeneration = program->generation;
+    pipeline          = &gPipelineStates.get(*program, state);
+
+    loose.clear();
+    block.destroy();
+
+    const BlockInfo* blockInfo =
+        program->findBlock(UniformId::of(kMaterialBlockName), GL_UNIFORM_BLOCK);
+    if (blockInfo)
+      block.allocate(blockInfo->dataSize);
+
+    for (auto& [name, u] : uniforms) {
+      u.location = -1;
+      u.offset   = -1;
+      u.type     = GL_NONE;
+
+      const UniformInfo* info = program->findUniform(UniformId::of(name));
+      if (info && blockInfo && info->blockIndex == static_cast<GLint>(blockInfo->index)) {
+        u.offset = info->offset;
+        u.type   = info->type;
+        block.write(u.offset, u.type, u.value);
+        continue;
+      }
+
+      u.location = info ? info->location : -1;
+      if (u.location != -1)
+        loose.push_back(&u);
+
+#ifndef NDEBUG
+      if (u.location == -1) {
+        LOGF_WARN("Uniform '{}' not found in program {}", name, program->id);
+      }
+#endif
+    }
+  }
+
+  void bind() const {
+    ASSERT_ALWAYS(pipeline);
+    pipeline->bind();
+    bindResources();
+  }
+
+  // Block, loose uniforms and textures; expects `pipeline` to be bound already.
+  void bindResources() const {
+    if (block.buffer) {
+      block.flush();
+      gGLState.bindBufferRange(
+          GL_UNIFORM_BUFFER, kMaterialBinding, block.buffer, 0, block.data.size());
+    }
+
+    for (const CachedUniform* u : loose) {
+      std::visit(
+          [&](auto&& v) {
+            using T = std::decay_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<T, int>)
+              glUniform1i(u->location, v);
+
+            else if constexpr (std::is_same_v<T, float>)
+              glUniform1f(u->location, v);
+
+            else if constexpr (std::is_same_v<T, glm::vec4>)
+              glUniform4fv(u->location, 1, glm::value_ptr(v));
+
+            else if constexpr (std::is_same_v<T, glm::mat4>)
+              glUniformMatrix4fv(u->location, 1, GL_FALSE, glm::value_ptr(v));
+          },
+          u->value);
+    }
+
+    for (const auto& t : textures)
+      gGLState.bindTexture(t.unit, t.target, t.texture);
+  }
+};
+
+struct Renderable {
+  const Mesh*     mesh     = nullptr;
+  const Material* material = nullptr;
+  glm::mat4       transform;
+
+  // What the vertex shader multiplies positions by: the transform with the mesh's position
+  // decode folded in.
+  glm::mat4 model() const { return mesh->decode.apply(transform); }
+
+  void draw() const {
+    ASSERT(mesh);
+    ASSERT(material);
+
+    material->bind();
+
+    // per-object uniforms
+    const glm::mat4 m = model();
+    material->program->setMat4("u_Model"_uid, glm::value_ptr(m));
+
+    mesh->draw();
+  }
+};
+
+struct Camera {
+  glm::vec3 position{0, 0, 3};
+
+  float yaw   = -90.0f; // degrees
+  float pitch = 0.0f;
+
+  float fov    = 60.0f; // degrees
+  float aspect = 16.0f / 9.0f;
+  float nearZ  = 0.1f;
+  float farZ   = 1000.0f;
+
+  float viewportHeight = 1080.0f; // pixels; LOD selection measures errors on it
+
+  glm::mat4 view;
+  glm::mat4 proj;
+  glm::mat4 viewProj;
+
+  // World-space planes (left, right, bottom, top, near, far) of viewProj, normalized so that
+  // dot(plane.xyz, p) + plane.w is the signed distance of p, positive inside.
+  std::array<glm::vec4, 6> frustum{};
+
+  void updateMatrices() {
+    glm::vec3 forward{cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
+                      sin(glm::radians(pitch)),
+                      sin(glm::radians(yaw)) * cos(glm::radians(pitch))};
+
+    glm::vec3 target = position + normalize(forward);
+    view             = glm::lookAt(position, target, glm::vec3{0, 1, 0});
+    proj             = glm::perspective(glm::radians(fov), aspect, nearZ, farZ);
+    viewProj         = proj * view;
+
+    const glm::mat4 rows = glm::transpose(viewProj);
+    for (int axis = 0; axis < 3; ++axis) {
+      frustum[axis * 2 + 0] = rows[3] + rows[axis];
+      frustum[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    for (glm::vec4& plane : frustum)
+      plane /= glm::length(glm::vec3(plane));
+  }
+  glm::vec3 forward() const {
+    return glm::normalize(glm::vec3{cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
+                                    sin(glm::radians(pitch)),
+                                    sin(glm::radians(yaw)) * cos(glm::radians(pitch))});
+  }
+
+  glm::vec3 right() const { return glm::normalize(glm::cross(forward(), glm::vec3{0, 1, 0})); }
+
+  // Projected height in pixels of a unit-sized object at distance 1.
+  float pixelsPerUnit() const {
+    return viewportHeight / (2.0f * std::tan(glm::radians(fov) * 0.5f));
+  }
+};
+
+// Per-frame camera constants RenderPass::render writes into its FrameUniform. Programs declare
+// the block with ProgramPipe::block<CameraBlock>(binding).
+struct CameraBlock {
+  glm::mat4 viewProj;
+  glm::mat4 view;
+  glm::mat4 proj;
+  glm::vec3 eye;
+  float     farZ;
+};
+
+template <>
+struct BlockDescription<CameraBlock> {
+  static constexpr const char* name   = "Camera";
+  static constexpr auto        fields = std::tuple{BLOCK_FIELD(CameraBlock, viewProj, "u_ViewProj"),
+                                                   BLOCK_FIELD(CameraBlock, view, "u_View"),
+                                                   BLOCK_FIELD(CameraBlock, proj, "u_Proj"),
+                                                   BLOCK_FIELD(CameraBlock, eye, "u_Eye"),
+                                                   BLOCK_FIELD(CameraBlock, farZ, "u_FarZ")};
+};
+static_assert(blockMatches<CameraBlock>(BlockLayout::Std140));
+
+// Frames the CPU may run ahead of the GPU with a ring-buffered FrameUniform.
+constexpr uint32_t kMaxFramesInFlight = 4;
+
+// Per-frame uniform block. With one frame in flight, update() is a glBufferSubData that the
+// driver may have to synchronize with the GPU. With more, the block lives in one persistently
+// mapped, coherent buffer split into per-frame slices: beginFrame() waits on the fence of the
+// slice it is about to overwrite and binds it with glBindBufferRange, update() is a memcpy, and
+// endFrame() fences the slice. Needs glBufferStorage (GL 4.4); FrameUniformPipe falls back to a
+// single slice when it is missing.
+struct FrameUniform {
+  GLuint buffer  = 0;
+  GLuint binding = 0;
+  size_t size    = 0;
+
+  uint32_t                               frames = 1; // slices in the ring
+  size_t                                 stride = 0; // slice size, rounded to the UBO alignment
+  uint32_t                               slice  = 0; // slice written this frame
+  std::byte*                             mapped = nullptr;
+  std::array<GLsync, kMaxFramesInFlight> fences{};
+  uint32_t                               stalls = 0; // beginFrame() calls that had to wait
+
+  FrameUniform() = default;
+  FrameUniform(GLuint buffer, GLuint binding, size_t size) :
+      buffer(buffer), binding(binding), size(size) {}
+
+  FrameUniform(const FrameUniform&)            = delete;
+  FrameUniform& operator=(const FrameUniform&) = delete;
+
+  FrameUniform(FrameUniform&& other) noexcept { *this = std::move(other); }
+
+  FrameUniform& operator=(FrameUniform&& other) noexcept {
+    destroy();
+    buffer       = other.buffer;
+    binding      = other.binding;
+    size         = other.size;
+    frames       = other.frames;
+    stride       = other.stride;
+    slice        = other.slice;
+    mapped       = other.mapped;
+    fences       = other.fences;
+    stalls       = other.stalls;
+    other.buffer = 0;
+    other.mapped = nullptr;
+    other.fences.fill(nullptr);
+    return *this;
+  }
+
+  bool ring() const { return mapped != nullptr; }
+
+  void beginFrame() {
+    if (!ring())
+      return;
+
+    slice = (slice + 1) % frames;
+    if (GLsync fence = fences[slice]) {
+      GLenum result = glClientWaitSync(fence, 0, 0);
+      if (result == GL_TIMEOUT_EXPIRED) {
+        ++stalls;
+        do {
+          result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+      }
+      CHECK(result != GL_WAIT_FAILED, "glClientWaitSync failed on slice {}", slice);
+      glDeleteSync(fence);
+      fences[slice] = nullptr;
+    }
+    gGLState.bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, slice * stride, size);
+  }
+
+  void update(const void* data, size_t bytes, size_t offset = 0) const {
+    ASSERT_ALWAYS(buffer);
+    ASSERT_ALWAYS(offset + bytes <= size);
+    gGLState.countUpload(bytes);
+    if (ring()) {
+      std::memcpy(mapped + slice * stride + offset, data, bytes);
+      return;
+    }
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data);
+  }
+
+  template <typename T>
+  void update(const T& block) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    update(&block, sizeof(T));
+  }
+
+  // Call once the frame's last command reading the block has been issued.
+  void endFrame() {
+    if (ring())
+      fences[slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  void destroy() {
+    for (GLsync& fence : fences) {
+      if (fence)
+        glDeleteSync(fence);
+      fence = nullptr;
+    }
+    if (buffer) {
+      // deleting the buffer also unmaps it
+      glDeleteBuffers(1, &buffer);
+      gGLState.forgetBuffer(buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+  }
+
+  ~FrameUniform() { destroy(); }
+};
+struct FrameUniformSpec {
+  GLuint   binding        = 0;
+  size_t   size           = 0;
+  uint32_t framesInFlight = 1;
+};
+struct FrameUniformPipe {
+  FrameUniformSpec spec;
+
+  FrameUniformPipe binding(GLuint b) const {
+    FrameUniformPipe next = *this;
+    next.spec.binding     = b;
+    return next;
+  }
+
+  FrameUniformPipe size(size_t s) const {
+    FrameUniformPipe next = *this;
+    next.spec.size        = s;
+    return next;
+  }
+
+  // Sized for the described struct T, which must have the std140 layout of its description.
+  template <typename T>
+  FrameUniformPipe block() const {
+    static_assert(blockMatches<T>(BlockLayout::Std140), "C++ struct does not match std140");
+    return size(sizeof(T));
+  }
+
+  FrameUniformPipe framesInFlight(uint32_t n) const {
+    FrameUniformPipe next    = *this;
+    next.spec.framesInFlight = n;
+    return next;
+  }
+
+  FrameUniform build() const {
+    ASSERT_ALWAYS(spec.size > 0);
+    ASSERT_ALWAYS(spec.framesInFlight >= 1 && spec.framesInFlight <= kMaxFramesInFlight);
+
+    GLuint ubo = 0;
+    glGenBuffers(1, &ubo);
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, ubo);
+
+    if (spec.framesInFlight > 1 && glBufferStorage) {
+      GLint alignment = 0;
+      glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+      size_t stride = (spec.size + alignment - 1) / alignment * alignment;
+
+      constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_UNIFORM_BUFFER, stride * spec.framesInFlight, nullptr, flags);
+      void* mapped = glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride * spec.framesInFlight, flags);
+      ASSERT_ALWAYS(mapped);
+
+      FrameUniform fu{ubo, spec.binding, spec.size};
+      fu.frames = spec.framesInFlight;
+      fu.stride = stride;
+      fu.slice  = spec.framesInFlight - 1; // first beginFrame() starts at slice 0
+      fu.mapped = static_cast<std::byte*>(mapped);
+      return fu;
+    }
+
+    if (spec.framesInFlight > 1)
+      LOG_WARN("glBufferStorage unavailable, FrameUniform falls back to glBufferSubData");
+
+    glBufferData(GL_UNIFORM_BUFFER, spec.size, nullptr, GL_DYNAMIC_DRAW);
+    gGLState.bindBufferBase(GL_UNIFORM_BUFFER, spec.binding, ubo);
+
+    return FrameUniform{ubo, spec.binding, spec.size};
+  }
+};
+
+// Per-instance model matrices are streamed into an SSBO once per frame. Instanced programs read
+//   layout(std430, binding = 1) readonly buffer Instances { mat4 u_Models[]; };
+//   mat4 model = u_Models[u_InstanceBase + gl_InstanceID];
+constexpr GLuint kInstanceBinding = 1;
+
+// Buffer rewritten every frame. Each upload orphans last frame's storage instead of waiting for
+// the GPU to finish reading it.
+struct StreamBuffer {
+  GLenum target   = GL_SHADER_STORAGE_BUFFER;
+  GLuint buffer   = 0;
+  size_t capacity = 0;
+
+  StreamBuffer() = default;
+  explicit StreamBuffer(GLenum target) : target(target) {}
+
+  StreamBuffer(const StreamBuffer&)            = delete;
+  StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+  StreamBuffer(StreamBuffer&& other) noexcept { *this = std::move(other); }
+
+  StreamBuffer& operator=(StreamBuffer&& other) noexcept {
+    destroy();
+    target         = other.target;
+    buffer         = other.buffer;
+    capacity       = other.capacity;
+    other.buffer   = 0;
+    other.capacity = 0;
+    return *this;
+  }
+
+  template <typename T>
+  void upload(std::span<const T> items) {
+    if (items.empty())
+      return;
+    if (!buffer)
+      glGenBuffers(1, &buffer);
+
+    gGLState.bindBuffer(target, buffer);
+    capacity = std::max(capacity, std::bit_ceil(items.size_bytes()));
+    glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, items.size_bytes(), items.data());
+    gGLState.countUpload(items.size_bytes());
+  }
+
+  void destroy() {
+    if (buffer) {
+      glDeleteBuffers(1, &buffer);
+      gGLState.forgetBuffer(buffer);
+    }
+    buffer   = 0;
+    capacity = 0;
+  }
+
+  ~StreamBuffer() { destroy(); }
+};
+
+// ---- program warm-up ----
+// Builds a manifest of programs at startup instead of on first use, so the first frame that
+// shows a material does not hitch. Each WarmupContext runs a worker thread that compiles and
+// links programs on a GL context sharing objects with the calling thread's. The calling thread
+// keeps everything that is not thread-safe (the program cache, reflection, gGLState) and primes
+// each finished program with a draw of one degenerate triangle into a 1x1 offscreen target, so
+// the driver also finishes the state-dependent compilation it would otherwise defer to the
+// program's first real draw. Compute programs are linked but not primed. Without contexts the
+// programs go through buildAsync and compile on the driver's threads instead.
+//
+//   ProgramWarmup warmup{.contexts = sharedContexts, .onProgress = drawLoadingBar};
+//   WarmupReport  report = warmup.run(manifest);
+struct WarmupEntry {
+  std::string name;
+  ProgramPipe pipe;
+  Program*    program = nullptr; // receives the result; LinkStatus::Failed when it did not build
+};
+
+// A context created by the application that shares objects with the one warm-up runs on.
+// makeCurrent is called on the worker thread before its first build, release before it exits.
+struct WarmupContext {
+  std::function<void()> makeCurrent;
+  std::function<void()> release;
+};
+
+struct WarmupTiming {
+  std::string name;
+  double      buildMs = 0; // preprocess, compile and link; without contexts, submit to completion
+  double      primeMs = 0;
+  bool        cached  = false; // loaded from the pipe's ProgramCache
+  bool        ok      = false;
+};
+
+struct WarmupReport {
+  std::vector<WarmupTiming> programs; // in manifest order
+  double                    totalMs = 0;
+  size_t                    failed  = 0;
+};
+
+struct WarmupProgress {
+  size_t              done;
+  size_t              total;
+  const WarmupTiming& program; // the one that just finished
+};
+
+struct ProgramWarmup {
+  std::vector<WarmupContext>                 contexts;   // one worker thread each
+  std::function<void(const WarmupProgress&)> onProgress; // on the calling thread
+  GLenum colorFormat = GL_RGBA8;            // priming target, match the real framebuffer
+  GLenum depthFormat = GL_DEPTH24_STENCIL8; // GL_NONE for none
+
+  WarmupReport run(std::span<WarmupEntry> manifest) const {
+    const auto   start = Clock::now();
+    WarmupReport report;
+    report.programs.resize(manifest.size());
+    for (size_t i = 0; i < manifest.size(); ++i) {
+      ASSERT_ALWAYS(manifest[i].program && "WarmupEntry without a Program to fill");
+      report.programs[i].name = manifest[i].name;
+    }
+
+    PrimeTarget target(colorFormat, depthFormat);
+    size_t      done   = 0;
+    auto        finish = [&](size_t i) {
+      const WarmupEntry& entry  = manifest[i];
+      WarmupTiming&      timing = report.programs[i];
+      timing.ok                 = entry.program->ready();
+      if (timing.ok && !computeOnly(entry.pipe)) {
+        const auto primeStart = Clock::now();
+        target.prime(*entry.program);
+        timing.primeMs = elapsedMs(primeStart);
+      }
+      report.failed += !timing.ok;
+      if (onProgress)
+        onProgress({++done, manifest.size(), timing});
+    };
+
+    if (contexts.empty())
+      buildAsync(manifest, report, finish);
+    else
+      buildOnWorkers(manifest, report, finish);
+
+    report.totalMs = elapsedMs(start);
+    LOGF_INFO("program warm-up: {} programs in {:.1f} ms, {} failed",
+              manifest.size(),
+              report.totalMs,
+              report.failed);
+    return report;
+  }
+
+private:
+  static bool computeOnly(const ProgramPipe& pipe) {
+    return std::ranges::any_of(
+        pipe.pipeline, [](const ShaderSpec& spec) { return spec.stage == ShaderStage::Compute; });
+  }
+
+  static void fail(const WarmupEntry& entry, std::string_view error) {
+    Program failed;
+    failed.status = LinkStatus::Failed;
+    entry.program->replace(std::move(failed));
+    LOGF_ERROR("program warm-up: {} failed: {}", entry.name, error);
+  }
+
+  // 1x1 framebuffer and an attribute-less VAO to prime programs with. Every vertex reads the
+  // same current attribute values, so the triangle has no area and nothing is written.
+  struct PrimeTarget {
+    GLuint fbo = 0, color = 0, depth = 0, vao = 0;
+
+    PrimeTarget(GLenum colorFormat, GLenum depthFormat) {
+      GLint previous = 0;
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+      glGenFramebuffers(1, &fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+
+      glGenRenderbuffers(1, &color);
+      glBindRenderbuffer(GL_RENDERBUFFER, color);
+      glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, 1, 1);
+      glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+      if (depthFormat != GL_NONE) {
+        const bool stencil =
+            depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8;
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, 1, 1);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER,
+                                  stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER,
+                                  depth);
+      }
+      ASSERT(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+
+      glGenVertexArrays(1, &vao);
+    }
+
+    PrimeTarget(const PrimeTarget&)            = delete;
+    PrimeTarget& operator=(const PrimeTarget&) = delete;
+
+    ~PrimeTarget() {
+      glDeleteFramebuffers(1, &fbo);
+      glDeleteRenderbuffers(1, &color);
+      if (depth)
+        glDeleteRenderbuffers(1, &depth);
+      glDeleteVertexArrays(1, &vao);
+      gGLState.forgetVertexArray(vao);
+    }
+
+    // Waits for the draw to execute, so the measured time includes the driver's deferred work.
+    void prime(const Program& program) const {
+      GLint previous = 0;
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+      program.use();
+      gGLState.bindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glFinish();
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+    }
+  };
+
+  template <typename Finish>
+  void buildAsync(std::span<WarmupEntry> manifest, WarmupReport& report, Finish&& finish) const {
+    std::vector<std::pair<size_t, Clock::time_point>> pending;
+    for (size_t i = 0; i < manifest.size(); ++i) {
+      const auto start = Clock::now();
+      try {
+        manifest[i].program->replace(manifest[i].pipe.buildAsync());
+      } catch (const std::exception& e) {
+        fail(manifest[i], e.what());
+        finish(i);
+        continue;
+      }
+      if (manifest[i].program->status == LinkStatus::Pending) {
+        pending.emplace_back(i, start);
+      } else {
+        report.programs[i].cached = true;
+        finish(i);
+      }
+    }
+
+    while (!pending.empty()) {
+      std::erase_if(pending, [&](const std::pair<size_t, Clock::time_point>& link) {
+        const auto [i, start] = link;
+        if (manifest[i].program->poll() == LinkStatus::Pending)
+          return false;
+        report.programs[i].buildMs = elapsedMs(start);
+        finish(i);
+        return true;
+      });
+      if (!pending.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  template <typename Finish>
+  void buildOnWorkers(std::span<WarmupEntry> manifest,
+                      WarmupReport&          report,
+                      Finish&&               finish) const {
+    struct Job {
+      size_t                                           entry;
+      std::vector<std::pair<ShaderStage, std::string>> stages;
+      uint64_t                                         key     = 0;
+      GLuint                                           id      = 0;
+      double                                           buildMs = 0;
+      std::string                                      error;
+    };
+
+    // preprocessing and cache lookups stay on this thread
+    std::vector<Job>    jobs;
+    std::vector<size_t> cached;
+    for (size_t i = 0; i < manifest.size(); ++i) {
+      const WarmupEntry& entry = manifest[i];
+      const auto         start = Clock::now();
+      Job                job{.entry = i};
+      try {
+        if (entry.pipe.pipeline.empty())
+          throw std::runtime_error("ProgramPipe: empty pipeline");
+        job.stages = entry.pipe.sources();
+      } catch (const std::exception& e) {
+        fail(entry, e.what());
+        finish(i);
+        continue;
+      }
+
+      if (ProgramCache* cache = entry.pipe.programCache) {
+        job.key = cache->key(job.stages);
+        if (GLuint id = cache->load(job.key)) {
+          entry.program->replace(Program{id});
+          entry.program->reflect();
+          report.programs[i].cached = true;
+          cached.push_back(i);
+          continue;
+        }
+        ++cache->stats.misses;
+      }
+      job.buildMs = elapsedMs(start);
+      jobs.push_back(std::move(job));
+    }
+
+    std::atomic<size_t>     next = 0;
+    std::mutex              mutex;
+    std::condition_variable built;
+    std::vector<size_t>     finished; // indices into jobs, guarded by mutex
+
+    std::vector<std::jthread> workers;
+    workers.reserve(contexts.size());
+    for (const WarmupContext& context : contexts)
+      workers.emplace_back([&] {
+        context.makeCurrent();
+        for (size_t j; (j = next++) < jobs.size();) {
+          Job&       job         = jobs[j];
+          const bool retrievable = manifest[job.entry].pipe.programCache != nullptr;
+          const auto start       = Clock::now();
+          try {
+            job.id = ProgramPipe::link(job.stages, retrievable);
+            glFinish(); // complete before another context uses it
+          } catch (const std::exception& e) {
+            job.error = e.what();
+          }
+          job.buildMs += elapsedMs(start);
+          {
+            std::lock_guard lock(mutex);
+            finished.push_back(j);
+          }
+          built.notify_one();
+        }
+        context.release();
+      });
+
+    // primed while the workers compile
+    for (size_t i : cached)
+      finish(i);
+
+    for (size_t remaining = jobs.size(); remaining > 0;) {
+      std::vector<size_t> batch;
+      {
+        std::unique_lock lock(mutex);
+        built.wait(lock, [&] { return !finished.empty(); });
+        batch.swap(finished);
+      }
+
+      for (size_t j : batch) {
+        Job&         job   = jobs[j];
+        WarmupEntry& entry = manifest[job.entry];
+        if (job.id) {
+          entry.program->replace(Program{job.id});
+          if (ProgramCache* cache = entry.pipe.programCache)
+            cache->store(job.key, job.id);
+          entry.program->reflect();
+        } else {
+          fail(entry, job.error);
+        }
+        report.programs[job.entry].buildMs = job.buildMs;
+        finish(job.entry);
+        --remaining;
+      }
+    }
+  }
+};
+
+// ---- compute ----
+// ComputePass binds a compute program's buffers and images and dispatches it. Every binding
+// declares how the shader accesses it: before a dispatch each one goes through
+// gGLState.consume() with the barrier bit of its kind of access, and afterwards the ones it
+// writes are reported with shaderWrote(). Chained dispatches therefore get exactly the
+// glMemoryBarrier bits they depend on, and none at all when nothing they read was written.
+// Other consumers of compute output do the same, e.g. a CPU readback:
+//   gGLState.consume(GL_BUFFER, buffer, GL_BUFFER_UPDATE_BARRIER_BIT);
+//   gGLState.flushBarriers();
+enum class Access : uint8_t { Read = 1, Write = 2, ReadWrite = 3 };
+
+constexpr bool writes(Access access) { return static_cast<uint8_t>(access) & 2; }
+
+constexpr GLenum toGLenum(Access access) {
+  switch (access) {
+    case Access::Read:
+      return GL_READ_ONLY;
+    case Access::Write:
+      return GL_WRITE_ONLY;
+    case Access::ReadWrite:
+      return GL_READ_WRITE;
+  }
+  throw std::logic_error("Unhandled Access");
+}
+
+struct ComputeBinding {
+  enum class Kind : uint8_t { StorageBuffer, UniformBuffer, Image, Texture };
+
+  Kind       kind;
+  GLuint     index;  // binding point, image unit or texture unit
+  GLuint     object; // buffer or texture
+  Access     access = Access::Read;
+  GLintptr   offset = 0; // buffers; size 0 binds the whole buffer
+  GLsizeiptr size   = 0;
+  GLenum     target = GL_TEXTURE_2D; // textures
+  GLenum     format = GL_RGBA8;      // images
+  GLint      level  = 0;             // images
+
+  GLenum resourceKind() const {
+    return kind == Kind::StorageBuffer || kind == Kind::UniformBuffer ? GL_BUFFER : GL_TEXTURE;
+  }
+
+  // The barrier bit that makes earlier shader writes visible to this binding.
+  GLbitfield barrierBit() const {
+    switch (kind) {
+      case Kind::StorageBuffer:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+      case Kind::UniformBuffer:
+        return GL_UNIFORM_BARRIER_BIT;
+      case Kind::Image:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+      case Kind::Texture:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    }
+    return GL_ALL_BARRIER_BITS;
+  }
+};
+
+struct ComputePassStats {
+  uint32_t dispatches = 0;
+  uint32_t barriers   = 0; // glMemoryBarrier calls issued for this pass's dispatches
+};
+
+struct ComputePass {
+  Program*                    program = nullptr; // non-owning reference
+  std::vector<ComputeBinding> bindings;
+  std::array<GLint, 3>        localSize{}; // work group size declared by the program
+  uint32_t                    programGeneration = ~0u;
+  ComputePassStats            stats;
+
+  // Swaps the object behind an existing binding, e.g. to ping-pong between two buffers.
+  void rebind(ComputeBinding::Kind kind, GLuint index, GLuint object) {
+    for (ComputeBinding& b : bindings)
+      if (b.kind == kind && b.index == index) {
+        b.object = object;
+        return;
+      }
+    ASSERT_ALWAYS(false && "ComputePass: no such binding");
+  }
+
+  // Work groups along x that cover `invocations` threads.
+  uint32_t groupsFor(uint32_t invocations) {
+    refresh();
+    const uint32_t size = static_cast<uint32_t>(std::max(localSize[0], 1));
+    return (invocations + size - 1) / size;
+  }
+
+  void dispatch(uint32_t x, uint32_t y = 1, uint32_t z = 1) {
+    begin();
+    glDispatchCompute(x, y, z);
+    end();
+  }
+
+  // Group counts come from a {x, y, z} uint triple at `offset` in `buffer`, which an earlier
+  // dispatch may have written.
+  void dispatchIndirect(GLuint buffer, GLintptr offset = 0) {
+    gGLState.consume(GL_BUFFER, buffer, GL_COMMAND_BARRIER_BIT);
+    begin();
+    gGLState.bindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer);
+    glDispatchComputeIndirect(offset);
+    end();
+  }
+
+private:
+  // Re-reads the work group size after the program was (re)linked.
+  void refresh() {
+    ASSERT_ALWAYS(program && program->ready());
+    if (programGeneration == program->generation)
+      return;
+    glGetProgramiv(program->id, GL_COMPUTE_WORK_GROUP_SIZE, localSize.data());
+    programGeneration = program->generation;
+  }
+
+  void begin() {
+    refresh();
+    for (const ComputeBinding& b : bindings) {
+      gGLState.consume(b.resourceKind(), b.object, b.barrierBit());
+
+      switch (b.kind) {
+        case ComputeBinding::Kind::StorageBuffer:
+        case ComputeBinding::Kind::UniformBuffer: {
+          const GLenum target = b.kind == ComputeBinding::Kind::StorageBuffer
+                                    ? GL_SHADER_STORAGE_BUFFER
+                                    : GL_UNIFORM_BUFFER;
+          if (b.size)
+            gGLState.bindBufferRange(target, b.index, b.object, b.offset, b.size);
+          else
+            gGLState.bindBufferBase(target, b.index, b.object);
+          break;
+        }
+        case ComputeBinding::Kind::Image:
+          glBindImageTexture(
+              b.index, b.object, b.level, GL_TRUE, 0, toGLenum(b.access), b.format);
+          break;
+        case ComputeBinding::Kind::Texture:
+          gGLState.bindTexture(b.index, b.target, b.object);
+          break;
+      }
+    }
+
+    const uint32_t barriers = gGLState.stats.barriers;
+    gGLState.flushBarriers();
+    stats.barriers += gGLState.stats.barriers - barriers;
+    program->use();
+  }
+
+  void end() {
+    ++stats.dispatches;
+    for (const ComputeBinding& b : bindings)
+      if (writes(b.access))
+        gGLState.shaderWrote(b.resourceKind(), b.object);
+  }
+};
+
+struct ComputePipe {
+  Program*                    computeProgram = nullptr;
+  std::vector<ComputeBinding> bindings;
+
+  // A linked program with a compute stage (ProgramPipe{}.add(ShaderStage::Compute, ...)).
+  ComputePipe program(Program& p) const {
+    ComputePipe next    = *this;
+    next.computeProgram = &p;
+    return next;
+  }
+
+  // layout(std430, binding = index) buffer; size 0 binds the whole buffer.
+  ComputePipe storage(GLuint     index,
+                      GLuint     buffer,
+                      Access     access,
+                      GLintptr   offset = 0,
+                      GLsizeiptr size   = 0) const {
+    return with({.kind   = ComputeBinding::Kind::StorageBuffer,
+                 .index  = index,
+                 .object = buffer,
+                 .access = access,
+                 .offset = offset,
+                 .size   = size});
+  }
+
+  // layout(std140, binding = index) uniform; read-only.
+  ComputePipe uniform(GLuint index, GLuint buffer, GLintptr offset = 0, GLsizeiptr size = 0) const {
+    return with({.kind   = ComputeBinding::Kind::UniformBuffer,
+                 .index  = index,
+                 .object = buffer,
+                 .offset = offset,
+                 .size   = size});
+  }
+
+  // layout(binding = unit, <format>) image*; all layers of `level`.
+  ComputePipe image(GLuint unit, GLuint texture, Access access, GLenum format, GLint level = 0)
+      const {
+    return with({.kind   = ComputeBinding::Kind::Image,
+                 .index  = unit,
+                 .object = texture,
+                 .access = access,
+                 .format = format,
+                 .level  = level});
+  }
+
+  // Sampled texture on `unit`; read-only.
+  ComputePipe texture(GLuint unit, GLenum target, GLuint texture) const {
+    return with({.kind   = ComputeBinding::Kind::Texture,
+                 .index  = unit,
+                 .object = texture,
+                 .target = target});
+  }
+
+  ComputePass build() const {
+    ASSERT_ALWAYS(computeProgram);
+    return ComputePass{.program = computeProgram, .bindings = bindings};
+  }
+
+private:
+  ComputePipe with(ComputeBinding binding) const {
+    ComputePipe next = *this;
+    next.bindings.push_back(binding);
+    return next;
+  }
+};
+
+// ---- draw sort keys ----
+// 64-bit key, most significant field first:
+//   opaque:      [layer:2][pipeline:10][material:14][mesh:14][depth:24]  state first, front-to-back
+//   transparent: [layer:2][depth:24][pipeline:10][material:14][mesh:14]  back-to-front
+// Ids are truncated to their field width; a collision only costs a redundant bind, never a
+// wrong one.
+namespace SortKey {
+constexpr int kLayerBits    = 2;
+constexpr int kPipelineBits = 10; // PipelineState::id
+constexpr int kMaterialBits = 14;
+constexpr int kMeshBits     = 14;
+constexpr int kDepthBits    = 24;
+static_assert(kLayerBits + kPipelineBits + kMaterialBits + kMeshBits + kDepthBits == 64);
+
+constexpr uint64_t field(uint64_t v, int bits) { return v & ((uint64_t{1} << bits) - 1); }
+
+// Linear view depth in [nearZ, farZ] -> [0, 2^24 - 1].
+inline uint32_t quantizeDepth(float viewDepth, float nearZ, float farZ) {
+  float t = std::clamp((viewDepth - nearZ) / (farZ - nearZ), 0.0f, 1.0f);
+  return static_cast<uint32_t>(t * float((1u << kDepthBits) - 1));
+}
+
+constexpr uint64_t make(RenderLayer layer,
+                        uint32_t    pipeline,
+                        uint32_t    material,
+                        uint32_t    mesh,
+                        uint32_t    depth) {
+  uint64_t state = field(pipeline, kPipelineBits) << (kMaterialBits + kMeshBits) |
+                   field(material, kMaterialBits) << kMeshBits | field(mesh, kMeshBits);
+  uint64_t key   = field(static_cast<uint64_t>(layer), kLayerBits) << (64 - kLayerBits);
+
+  if (layer == RenderLayer::Transparent) {
+    uint64_t farToNear = field(~uint64_t{depth}, kDepthBits);
+    return key | farToNear << (64 - kLayerBits - kDepthBits) | state;
+  }
+  return key | state << kDepthBits | field(depth, kDepthBits);
+}
+} // namespace SortKey
+
+struct DrawItem {
+  uint64_t        key;
+  Renderable*     object;
+  const Material* material; // object->material, or its fallback while that is not ready
+  uint32_t        lod = 0;  // level of detail of object->mesh
+};
+
+// LSD radix sort over the key, one byte per pass. Passes where every item shares the same byte
+// are skipped, so scenes with few distinct programs/materials pay for far fewer than 8 passes.
+// The sort is stable, so equal keys keep their insertion order.
+inline void radixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch) {
+  const size_t n = items.size();
+  if (n < 2)
+    return;
+  scratch.resize(n);
+
+  std::array<std::array<uint32_t, 256>, 8> histograms{};
+  for (const DrawItem& item : items)
+    for (int b = 0; b < 8; ++b)
+      ++histograms[b][(item.key >> (b * 8)) & 0xFF];
+
+  DrawItem* src = items.data();
+  DrawItem* dst = scratch.data();
+
+  for (int b = 0; b < 8; ++b) {
+    auto&    counts = histograms[b];
+    unsigned shift  = b * 8;
+    if (counts[(src[0].key >> shift) & 0xFF] == n)
+      continue;
+
+    uint32_t sum = 0;
+    for (uint32_t& c : counts) {
+      uint32_t count = c;
+      c              = sum;
+      sum += count;
+    }
+    for (size_t i = 0; i < n; ++i)
+      dst[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+    std::swap(src, dst);
+  }
+
+  if (src != items.data())
+    std::copy(src, src + n, items.data());
+}
+
+// ---- frustum culling ----
+// Largest factor by which `transform` stretches any object-space length.
+inline float maxScale(const glm::mat4& transform) {
+  return std::sqrt(std::max({glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                             glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                             glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))}));
+}
+
+// Bounding sphere of `bounds` under `transform` as (center, radius). Meshes without bounds get an
+// infinite radius and are never culled.
+inline glm::vec4 worldSphere(const glm::vec4& sphere, const glm::mat4& transform) {
+  glm::vec3 c = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+  return {c, sphere.w * maxScale(transform)};
+}
+
+inline glm::vec4 worldSphere(const Bounds& bounds, const glm::mat4& transform) {
+  if (!bounds.valid())
+    return {glm::vec3(transform[3]), std::numeric_limits<float>::infinity()};
+  return worldSphere(glm::vec4(bounds.center, bounds.radius), transform);
+}
+
+// Smallest signed distance of the sphere's center to one of the planes: below -radius the sphere
+// is fully outside, at radius or more fully inside.
+inline float frustumDistance(const std::array<glm::vec4, 6>& planes, const glm::vec4& sphere) {
+  float nearest = std::numeric_limits<float>::infinity();
+  for (const glm::vec4& plane : planes)
+    nearest = std::min(nearest, glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w);
+  return nearest;
+}
+
+// World-space bounding spheres of a RenderPass's objects in SoA form, so the plane test runs eight
+// objects per AVX2 iteration. Objects with unknown bounds get an infinite radius and always pass.
+struct CullSet {
+  std::vector<float>   x, y, z, radius;
+  std::vector<uint8_t> visible;
+
+  void resize(size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    radius.resize(n);
+    visible.resize(n);
+  }
+
+  void store(size_t i, const Bounds& bounds, const glm::mat4& transform) {
+    const glm::vec4 sphere = worldSphere(bounds, transform);
+    x[i]                   = sphere.x;
+    y[i]                   = sphere.y;
+    z[i]                   = sphere.z;
+    radius[i]              = sphere.w;
+  }
+};
+
+// Marks spheres [begin, end) of `set` visible unless they lie fully outside one of the planes.
+inline void cullSpheres(const std::array<glm::vec4, 6>& planes,
+                        CullSet&                        set,
+                        size_t                          begin,
+                        size_t                          end) {
+  size_t i = begin;
+
+#if defined(__AVX2__)
+  __m256 px[6], py[6], pz[6], pw[6];
+  for (int p = 0; p < 6; ++p) {
+    px[p] = _mm256_set1_ps(planes[p].x);
+    py[p] = _mm256_set1_ps(planes[p].y);
+    pz[p] = _mm256_set1_ps(planes[p].z);
+    pw[p] = _mm256_set1_ps(planes[p].w);
+  }
+
+  for (; i + 8 <= end; i += 8) {
+    __m256 x      = _mm256_loadu_ps(set.x.data() + i);
+    __m256 y      = _mm256_loadu_ps(set.y.data() + i);
+    __m256 z      = _mm256_loadu_ps(set.z.data() + i);
+    __m256 negR   = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(set.radius.data() + i));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (int p = 0; p < 6; ++p) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+          _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int lane = 0; lane < 8; ++lane)
+      set.visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+  }
+#endif
+
+  for (; i < end; ++i) {
+    bool inside = true;
+    for (const glm::vec4& plane : planes)
+      inside &= plane.x * set.x[i] + plane.y * set.y[i] + plane.z * set.z[i] + plane.w >=
+                -set.radius[i];
+    set.visible[i] = inside;
+  }
+}
+
+// Per-frame submission counters, reset by every RenderPass::render.
+struct RenderStats {
+  uint32_t culled          = 0; // objects rejected by the frustum
+  uint32_t clustersCulled  = 0; // meshlets rejected by the frustum or their normal cone
+  uint32_t draws           = 0; // objects drawn
+  uint32_t drawCalls       = 0; // glDraw* calls issued, one per instanced run
+  uint32_t programChanges  = 0; // PipelineState switches: program and/or render state
+  uint32_t materialChanges = 0;
+  uint32_t meshChanges     = 0; // including switches between levels of detail
+  uint64_t triangles       = 0; // submitted on the CPU paths, after LOD selection
+
+  uint32_t stateChanges() const { return programChanges + materialChanges + meshChanges; }
+
+  RenderStats& operator+=(const RenderStats& o) {
+    culled += o.culled;
+    clustersCulled += o.clustersCulled;
+    draws += o.draws;
+    drawCalls += o.drawCalls;
+    programChanges += o.programChanges;
+    materialChanges += o.materialChanges;
+    meshChanges += o.meshChanges;
+    triangles += o.triangles;
+    return *this;
+  }
+};
+
+// Layout fixed by GL for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint  baseVertex;
+  GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20);
+
+// Consecutive indirect commands sharing a material, issued as one multi-draw.
+struct IndirectBucket {
+  const Material* material;
+  uint32_t        firstCommand;
+  uint32_t        commandCount;
+};
+
+// ---- command recording ----
+// RenderPass::submit records draws into per-thread CommandBuffers and replays them on the GL
+// thread. Commands are POD and reference scene objects by pointer and transforms by queue index.
+enum class RenderOp : uint8_t {
+  BindPipeline,    // pipeline->bind(): program and render state
+  BindMaterial,    // material->bindResources()
+  BindMesh,        // bind the mesh's VAO; later draws use it at level of detail `value`
+  SetInstanceBase, // u_InstanceBase = value, the run's first slot in the instance buffer
+  SetModel,        // u_Model = instanceModels[value]
+  Draw,            // `value` instances of the current mesh and level
+};
+
+struct RenderCommand {
+  RenderOp op;
+  uint32_t value;
+  union {
+    const PipelineState* pipeline;
+    const Material*      material;
+    const Mesh*          mesh;
+  };
+};
+static_assert(sizeof(RenderCommand) == 16 && std::is_trivially_copyable_v<RenderCommand>);
+
+struct CommandBuffer {
+  std::vector<RenderCommand> commands;
+  RenderStats                stats; // what replaying `commands` will issue
+
+  void clear() {
+    commands.clear();
+    stats = {};
+  }
+
+  void bindPipeline(const PipelineState* p) {
+    commands.push_back({.op = RenderOp::BindPipeline, .value = 0, .pipeline = p});
+    ++stats.programChanges;
+  }
+
+  void bindMaterial(const Material* m) {
+    commands.push_back({.op = RenderOp::BindMaterial, .value = 0, .material = m});
+    ++stats.materialChanges;
+  }
+
+  void bindMesh(const Mesh* m, uint32_t lod) {
+    commands.push_back({.op = RenderOp::BindMesh, .value = lod, .mesh = m});
+    ++stats.meshChanges;
+  }
+
+  void setInstanceBase(uint32_t slot) {
+    commands.push_back({.op = RenderOp::SetInstanceBase, .value = slot, .pipeline = nullptr});
+  }
+
+  void setModel(uint32_t slot) {
+    commands.push_back({.op = RenderOp::SetModel, .value = slot, .pipeline = nullptr});
+  }
+
+  void draw(uint32_t instances, uint32_t triangles) {
+    commands.push_back({.op = RenderOp::Draw, .value = instances, .pipeline = nullptr});
+    stats.draws += instances;
+    stats.triangles += uint64_t{instances} * triangles;
+    ++stats.drawCalls;
+  }
+};
+
+// ---- GPU culling ----
+// Culling on the GPU for passes drawn from a GeometryHeap. The objects' world-space bounding
+// spheres, transforms and draw ranges are uploaded once, grouped by material. Each frame a compute
+// pass tests every sphere against the frustum in the FrameUniform camera block and, when a
+// DepthPyramid from the previous frame is available, against its depth. Survivors are appended
+// to their material's range of the command buffer through an atomic counter, and RenderPass
+// draws each range with glMultiDrawElementsIndirectCount. Every visible object becomes one
+// command whose baseInstance is the object's index. The CPU cost does not grow with the object
+// count, and nothing is read back.
+
+// Hierarchical max-depth buffer: level 0 copies a depth texture, every further level keeps the
+// farthest depth of the 2x2 (3 on odd edges) texels below it.
+constexpr const char* kDepthPyramidSource = R"GLSL(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 1, r32f) uniform writeonly image2D u_Dst;
+#ifdef FROM_DEPTH
+layout(binding = 0) uniform sampler2D u_Depth;
+#else
+layout(binding = 0, r32f) uniform readonly image2D u_Src;
+#endif
+
+void main() {
+  ivec2 p    = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(u_Dst);
+  if (any(greaterThanEqual(p, size)))
+    return;
+
+#ifdef FROM_DEPTH
+  float depth = texelFetch(u_Depth, p, 0).r;
+#else
+  ivec2 src   = imageSize(u_Src);
+  ivec2 reach = ivec2(p.x == size.x - 1 && (src.x & 1) != 0 ? 2 : 1,
+                      p.y == size.y - 1 && (src.y & 1) != 0 ? 2 : 1);
+  float depth = 0.0;
+  for (int y = 0; y <= reach.y; ++y)
+    for (int x = 0; x <= reach.x; ++x)
+      depth = max(depth, imageLoad(u_Src, min(2 * p + ivec2(x, y), src - 1)).r);
+#endif
+  imageStore(u_Dst, p, vec4(depth));
+}
+)GLSL";
+
+struct DepthPyramid {
+  GLuint    texture  = 0; // GL_R32F, full mip chain
+  GLsizei   width    = 0;
+  GLsizei   height   = 0;
+  GLsizei   levels   = 0;
+  glm::mat4 viewProj = glm::mat4(1.0f); // camera the source depth was rendered with
+  bool      valid    = false;           // built at least once
+
+  Program                  fromDepth;
+  Program                  reduce;
+  std::vector<ComputePass> passes; // one per level
+
+  DepthPyramid() = default;
+
+  DepthPyramid(const DepthPyramid&)            = delete;
+  DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+  ~DepthPyramid() { destroy(); }
+
+  // Rebuilds the pyramid from the frame just rendered into `depthTexture` (width x height) with
+  // `frameViewProj`; the next frame's GPU culling tests against it.
+  void build(GLuint depthTexture, GLsizei w, GLsizei h, const glm::mat4& frameViewProj) {
+    if (w != width || h != height)
+      allocate(depthTexture, w, h);
+    passes[0].rebind(ComputeBinding::Kind::Texture, 0, depthTexture);
+
+    for (GLsizei level = 0; level < levels; ++level) {
+      const uint32_t lw = static_cast<uint32_t>(std::max(width >> level, 1));
+      const uint32_t lh = static_cast<uint32_t>(std::max(height >> level, 1));
+      passes[level].dispatch((lw + 7) / 8, (lh + 7) / 8);
+    }
+    viewProj = frameViewProj;
+    valid    = true;
+  }
+
+  void destroy() {
+    if (texture) {
+      glDeleteTextures(1, &texture);
+      gGLState.forgetTexture(texture);
+    }
+    texture = 0;
+    width = height = levels = 0;
+    valid                   = false;
+    passes.clear();
+  }
+
+private:
+  void allocate(GLuint depthTexture, GLsizei w, GLsizei h) {
+    destroy();
+    width  = w;
+    height = h;
+    levels = static_cast<GLsizei>(std::bit_width(static_cast<uint32_t>(std::max(w, h))));
+
+    glGenTextures(1, &texture);
+    gGLState.bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    if (!fromDepth.id) {
+      const ProgramPipe pipe =
+          ProgramPipe{}.add(ShaderStage::Compute, EmbeddedSource{kDepthPyramidSource});
+      fromDepth = pipe.define("FROM_DEPTH").build();
+      reduce    = pipe.build();
+    }
+
+    passes.push_back(ComputePipe{}
+                         .program(fromDepth)
+                         .texture(0, GL_TEXTURE_2D, depthTexture)
+                         .image(1, texture, Access::Write, GL_R32F, 0)
+                         .build());
+    for (GLint level = 1; level < levels; ++level)
+      passes.push_back(ComputePipe{}
+                           .program(reduce)
+                           .image(0, texture, Access::Read, GL_R32F, level - 1)
+                           .image(1, texture, Access::Write, GL_R32F, level)
+                           .build());
+  }
+};
+
+constexpr const char* kGpuCullSource = R"GLSL(
+#version 430 core
+layout(local_size_x = 64) in;
+
+// Camera and CullParams blocks injected by ProgramPipe::block
+
+// one object, or one meshlet of it
+struct CullObject {
+  vec4 sphere; // world-space center, radius
+  vec4 cone;   // object-space normal cone: axis, cutoff; a cutoff of 1 never culls
+  vec4 local;  // object-space sphere the cone is tested against
+  uint indexCount;
+  uint firstIndex;
+  int  baseVertex;
+  uint bucket;
+  uint object; // transform index, the command's baseInstance
+  uint lod;    // 0: draw as is, 1: the object's level, 2: only at level 0, 3: only above it
+};
+
+struct LodObject {
+  vec4  sphere; // world space
+  uint  firstLevel;
+  uint  levelCount;
+  float scale; // object-space errors to world space
+};
+
+struct Level {
+  uint  firstIndex;
+  uint  indexCount;
+  float error;
+};
+
+struct DrawCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int  baseVertex;
+  uint baseInstance;
+};
+
+layout(std430, binding = 3) readonly buffer Objects { CullObject objects[]; };
+layout(std430, binding = 4) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 5) buffer Counts { uint counts[]; };
+layout(std430, binding = 6) readonly buffer Buckets { uint bucketFirst[]; };
+layout(std430, binding = 7) readonly buffer Inverses { mat4 inverses[]; }; // world to object
+layout(std430, binding = 8) readonly buffer LodObjects { LodObject lodObjects[]; };
+layout(std430, binding = 9) readonly buffer Levels { Level levels[]; };
+
+layout(binding = 0) uniform sampler2D u_DepthPyramid;
+
+bool inFrustum(vec4 s) {
+  mat4 rows = transpose(u_ViewProj);
+  for (int axis = 0; axis < 3; ++axis) {
+    vec4 lo = rows[3] + rows[axis];
+    vec4 hi = rows[3] - rows[axis];
+    if (dot(lo.xyz, s.xyz) + lo.w < -s.w * length(lo.xyz) ||
+        dot(hi.xyz, s.xyz) + hi.w < -s.w * length(hi.xyz))
+      return false;
+  }
+  return true;
+}
+
+// Every triangle faces away from the eye; see backFacing(const Meshlet&, ...).
+bool backFacing(CullObject o) {
+  if (o.cone.w >= 1.0)
+    return false;
+  vec3 d = o.local.xyz - (inverses[o.object] * vec4(u_Eye, 1.0)).xyz;
+  return dot(d, o.cone.xyz) >= o.cone.w * length(d) + o.local.w;
+}
+
+// Coarsest level whose error covers at most u_Lod.y pixels; see selectLod.
+uint selectLevel(LodObject l) {
+  float d     = max(distance(l.sphere.xyz, u_Eye) - l.sphere.w, u_Lod.z);
+  uint  level = 0u;
+  while (level + 1u < l.levelCount &&
+         levels[l.firstLevel + level + 1u].error * l.scale * u_Lod.x <= u_Lod.y * d)
+    ++level;
+  return level;
+}
+
+// Conservative: the sphere's box must lie behind the farthest depth in its screen rectangle.
+bool occluded(vec4 s) {
+  vec3 lo = vec3(1.0);
+  vec3 hi = vec3(-1.0);
+  for (int i = 0; i < 8; ++i) {
+    vec3 corner = s.xyz + s.w * vec3((i & 1) != 0 ? 1.0 : -1.0,
+                                     (i & 2) != 0 ? 1.0 : -1.0,
+                                     (i & 4) != 0 ? 1.0 : -1.0);
+    vec4 clip   = u_PrevViewProj * vec4(corner, 1.0);
+    if (clip.w <= 0.0)
+      return false; // crosses the camera plane
+    lo = min(lo, clip.xyz / clip.w);
+    hi = max(hi, clip.xyz / clip.w);
+  }
+
+  vec2  uvLo    = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);
+  vec2  uvHi    = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);
+  vec2  extent  = (uvHi - uvLo) * u_Pyramid.xy;
+  int   level   = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))),
+                        0, int(u_Pyramid.z) - 1);
+  ivec2 size    = max(ivec2(u_Pyramid.xy) >> level, ivec2(1));
+  ivec2 a       = min(ivec2(uvLo * vec2(size)), size - 1);
+  ivec2 b       = min(ivec2(uvHi * vec2(size)), size - 1);
+  float farthest = max(max(texelFetch(u_DepthPyramid, a, level).r,
+                           texelFetch(u_DepthPyramid, ivec2(b.x, a.y), level).r),
+                       max(texelFetch(u_DepthPyramid, ivec2(a.x, b.y), level).r,
+                           texelFetch(u_DepthPyramid, b, level).r));
+  return lo.z * 0.5 + 0.5 > farthest;
+}
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= u_Objects.x)
+    return;
+
+  CullObject o       = objects[i];
+  bool       culling = u_Objects.y != 0u;
+  if ((culling && !inFrustum(o.sphere)) || backFacing(o))
+    return;
+  if (o.lod != 0u) {
+    LodObject l     = lodObjects[o.object];
+    uint      level = selectLevel(l);
+    if ((o.lod == 2u && level != 0u) || (o.lod == 3u && level == 0u))
+      return;
+    if (o.lod != 2u) {
+      o.indexCount = levels[l.firstLevel + level].indexCount;
+      o.firstIndex = levels[l.firstLevel + level].firstIndex;
+    }
+  }
+  if (culling && u_Pyramid.w > 0.0 && !isinf(o.sphere.w) && occluded(o.sphere))
+    return;
+
+  uint slot      = bucketFirst[o.bucket] + atomicAdd(counts[o.bucket], 1u);
+  commands[slot] = DrawCommand(o.indexCount, 1u, o.firstIndex, o.baseVertex, o.object);
+}
+)GLSL";
+
+// The objects' shader storage binding is followed by the commands, counts, buckets, inverses, LOD
+// objects and levels.
+constexpr GLuint kCullParamsBinding  = 3; // uniform
+constexpr GLuint kCullObjectsBinding = 3; // shader storage
+
+// Per-object (or per-meshlet) input of kGpuCullSource, std430.
+struct GpuCullObject {
+  glm::vec4 sphere;
+  glm::vec4 cone{0.0f, 0.0f, 1.0f, 1.0f};
+  glm::vec4 local{0.0f};
+  uint32_t  indexCount;
+  uint32_t  firstIndex;
+  int32_t   baseVertex;
+  uint32_t  bucket;
+  uint32_t  object;
+  uint32_t  lod = 0; // GpuCuller::kLod*
+  uint32_t  padding[2]{};
+};
+static_assert(sizeof(GpuCullObject) == 80);
+
+// Per-object and per-level inputs of the compute LOD selection, std430.
+struct GpuLodObject {
+  glm::vec4 sphere;
+  uint32_t  firstLevel;
+  uint32_t  levelCount;
+  float     scale;
+  uint32_t  padding = 0;
+};
+static_assert(sizeof(GpuLodObject) == 32);
+
+struct GpuLevel {
+  uint32_t firstIndex; // absolute in the heap's index buffer
+  uint32_t indexCount;
+  float    error;
+};
+static_assert(sizeof(GpuLevel) == 12);
+
+struct GpuCullParams {
+  glm::mat4  prevViewProj; // camera of the depth pyramid
+  glm::vec4  pyramid;      // width, height, levels; w > 0 enables occlusion culling
+  glm::vec4  lod;          // Camera::pixelsPerUnit, RenderPass::lodThreshold, Camera::nearZ
+  glm::uvec4 objects;      // x: GpuCullObject count, y: 0 skips the frustum and occlusion tests
+};
+
+template <>
+struct BlockDescription<GpuCullParams> {
+  static constexpr const char* name = "CullParams";
+  static constexpr auto        fields =
+      std::tuple{BLOCK_FIELD(GpuCullParams, prevViewProj, "u_PrevViewProj"),
+                 BLOCK_FIELD(GpuCullParams, pyramid, "u_Pyramid"),
+                 BLOCK_FIELD(GpuCullParams, lod, "u_Lod"),
+                 BLOCK_FIELD(GpuCullParams, objects, "u_Objects")};
+};
+
+// glMultiDrawElementsIndirectCount (GL 4.6 or GL_ARB_indirect_parameters). Without it the whole
+// command range is drawn, with the slots no object claimed zeroed beforehand.
+inline bool indirectCountSupported() {
+  static const bool supported = [] {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return glMultiDrawElementsIndirectCount &&
+           (major * 10 + minor >= 46 || glExtensionSupported("GL_ARB_indirect_parameters"));
+  }();
+  return supported;
+}
+
+struct GpuCuller {
+  Program     program;
+  ComputePass pass;
+
+  GLuint objectBuffer  = 0; // GpuCullObject per object, or per meshlet of clustered objects
+  GLuint transforms    = 0; // mat4 per object, bound at kInstanceBinding for drawing
+  GLuint commandBuffer = 0; // DrawElementsIndirectCommand per GpuCullObject, bucket ranges
+  GLuint counts        = 0; // visible commands per bucket, the parameter buffer
+  GLuint bucketFirsts  = 0; // first command of each bucket
+  GLuint params        = 0; // GpuCullParams
+  GLuint inverses      = 0; // inverse transform per object, for the normal cone test
+  GLuint lodObjects    = 0; // GpuLodObject per object
+  GLuint levels        = 0; // GpuLevel per level of detail of every mesh with levels
+
+  // GpuCullObject::lod: draw the entry as is, draw the object's selected level, draw the entry
+  // (a meshlet) only at level 0, or draw the selected level only above 0.
+  static constexpr uint32_t kLodFixed  = 0;
+  static constexpr uint32_t kLodAny    = 1;
+  static constexpr uint32_t kLodFull   = 2;
+  static constexpr uint32_t kLodCoarse = 3;
+
+  std::array<size_t, 9>       capacities{}; // bytes allocated for each of buffers()
+  std::vector<IndirectBucket> buckets;      // commandCount is the range capacity
+  uint32_t                    objectCount = 0;
+  uint32_t                    cullCount   = 0;    // GpuCullObjects, one thread each
+  bool                        dirty       = true; // objects changed, upload() before culling
+
+  GpuCuller() = default;
+
+  GpuCuller(const GpuCuller&)            = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+
+  GpuCuller(GpuCuller&& other) noexcept { *this = std::move(other); }
+
+  GpuCuller& operator=(GpuCuller&& other) noexcept {
+    destroy();
+    program      = std::move(other.program);
+    pass         = std::move(other.pass);
+    pass.program = &program;
+    const auto mine   = buffers();
+    const auto theirs = other.buffers();
+    for (size_t i = 0; i < mine.size(); ++i)
+      *mine[i] = std::exchange(*theirs[i], 0);
+    capacities  = std::exchange(other.capacities, {});
+    buckets     = std::move(other.buckets);
+    objectCount = other.objectCount;
+    cullCount   = other.cullCount;
+    dirty       = other.dirty;
+    return *this;
+  }
+
+  ~GpuCuller() { destroy(); }
+
+  std::array<GLuint*, 9> buffers() {
+    return {&objectBuffer,
+            &transforms,
+            &commandBuffer,
+            &counts,
+            &bucketFirsts,
+            &params,
+            &inverses,
+            &lodObjects,
+            &levels};
+  }
+
+  // Uploads spheres, transforms and draw ranges of `objects`, grouped by program and material, and
+  // sizes the command buffer. Every mesh must come from `heap`; the camera block is read from
+  // `cameraBinding`. With `clusters`, objects whose mesh has meshlets are culled per meshlet.
+  // Objects whose mesh has levels of detail pick one per frame; a meshlet-culled object then
+  // also gets an entry that stands in for its meshlets above level 0. The buffers are rewritten in
+  // place while the data fits and only reallocated to grow.
+  void upload(std::span<Renderable* const> objects,
+              const GeometryHeap&           heap,
+              GLuint                        cameraBinding,
+              bool                          clusters) {
+    if (!objectBuffer) {
+      for (GLuint* buffer : buffers())
+        glGenBuffers(1, buffer);
+      program = ProgramPipe{}
+                    .add(ShaderStage::Compute, EmbeddedSource{kGpuCullSource})
+                    .block<CameraBlock>(cameraBinding)
+                    .block<GpuCullParams>(kCullParamsBinding)
+                    .build();
+      pass    = ComputePipe{}
+                 .program(program)
+                 .uniform(kCullParamsBinding, params)
+                 .storage(kCullObjectsBinding + 0, objectBuffer, Access::Read)
+                 .storage(kCullObjectsBinding + 1, commandBuffer, Access::Write)
+                 .storage(kCullObjectsBinding + 2, counts, Access::ReadWrite)
+                 .storage(kCullObjectsBinding + 3, bucketFirsts, Access::Read)
+                 .storage(kCullObjectsBinding + 4, inverses, Access::Read)
+                 .storage(kCullObjectsBinding + 5, lodObjects, Access::Read)
+                 .storage(kCullObjectsBinding + 6, levels, Access::Read)
+                 .texture(0, GL_TEXTURE_2D, 0)
+                 .build();
+    }
+
+    // opaque buckets first, as on the CPU paths; materials still linking have no pipeline yet and
+    // sort last within their layer
+    std::vector<const Renderable*> order(objects.begin(), objects.end());
+    std::ranges::sort(order, {}, [](const Renderable* r) {
+      const PipelineState* pipeline = r->material->pipeline;
+      return std::tuple(r->material->layer,
+                        pipeline ? pipeline->id : UINT32_MAX,
+                        r->material->sortId,
+                        r->mesh->sortId);
+    });
+
+    std::vector<GpuCullObject>                cull;
+    std::vector<glm::mat4>                    models, inverseModels;
+    std::vector<GLuint>                       firsts;
+    std::vector<GpuLodObject>                 lodObjectData;
+    std::vector<GpuLevel>                     levelData;
+    std::unordered_map<const Mesh*, uint32_t> meshLevels; // first level, shared by instances
+    cull.reserve(order.size());
+    models.reserve(order.size());
+    buckets.clear();
+
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      const Renderable& r    = *order[i];
+      const Mesh&       mesh = *r.mesh;
+      ASSERT_ALWAYS(mesh.heapId == heap.id);
+      // commands within a bucket land in any order, so nothing here can be drawn back-to-front
+      ASSERT_ALWAYS(r.material->layer == RenderLayer::Opaque &&
+                    "GPU culling draws opaque materials only; keep transparent ones in a CPU pass");
+
+      if (buckets.empty() || buckets.back().material != r.material) {
+        buckets.push_back({r.material, static_cast<uint32_t>(cull.size()), 0});
+        firsts.push_back(static_cast<GLuint>(cull.size()));
+      }
+      models.push_back(r.model());
+      inverseModels.push_back(glm::inverse(r.transform));
+
+      const bool lods = mesh.lods.size() > 1;
+      auto [level, added] = meshLevels.try_emplace(&mesh, static_cast<uint32_t>(levelData.size()));
+      if (added && lods)
+        for (const MeshLod& lod : mesh.lods)
+          levelData.push_back({mesh.firstIndex + lod.firstIndex, lod.indexCount, lod.error});
+      lodObjectData.push_back({.sphere     = worldSphere(mesh.bounds, r.transform),
+                               .firstLevel = level->second,
+                               .levelCount = lods ? static_cast<uint32_t>(mesh.lods.size()) : 1,
+                               .scale      = maxScale(r.transform)});
+
+      const GpuCullObject whole{.sphere     = lodObjectData.back().sphere,
+                                .indexCount = static_cast<uint32_t>(mesh.indexCount),
+                                .firstIndex = mesh.firstIndex,
+                                .baseVertex = mesh.baseVertex,
+                                .bucket     = static_cast<uint32_t>(buckets.size() - 1),
+                                .object     = i,
+                                .lod        = lods ? kLodAny : kLodFixed};
+      if (!clusters || mesh.meshlets.empty()) {
+        cull.push_back(whole);
+        ++buckets.back().commandCount;
+        continue;
+      }
+      if (lods) {
+        cull.emplace_back(whole).lod = kLodCoarse;
+        ++buckets.back().commandCount;
+      }
+
+      // the fallbacks drawn until the material is ready must cull back faces as well
+      bool cones = true;
+      for (const Material* m = r.material; m; m = m->fallback)
+        cones &= culledBackFaces(m->state.raster, r.transform);
+      for (const Meshlet& meshlet : mesh.meshlets) {
+        GpuCullObject& o = cull.emplace_back(whole);
+        o.sphere         = worldSphere(meshlet.sphere, r.transform);
+        o.cone           = cones ? meshlet.cone : glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        o.local          = meshlet.sphere;
+        o.indexCount     = meshlet.indexCount;
+        o.firstIndex     = mesh.firstIndex + meshlet.firstIndex;
+        o.lod            = lods ? kLodFull : kLodFixed;
+      }
+      buckets.back().commandCount += static_cast<uint32_t>(mesh.meshlets.size());
+    }
+    objectCount = static_cast<uint32_t>(order.size());
+    cullCount   = static_cast<uint32_t>(cull.size());
+
+    // commands and counts (no data) are rewritten by every cull(), so they only need the room
+    auto store = [this](GLuint& buffer, size_t bytes, const void* data) {
+      const auto all      = buffers();
+      size_t&    capacity = capacities[std::ranges::find(all, &buffer) - all.begin()];
+      gGLState.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+      if (bytes > capacity) {
+        capacity = std::bit_ceil(std::max<size_t>(bytes, 4));
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+      }
+      if (data && bytes) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, data);
+        gGLState.countUpload(bytes);
+      }
+    };
+    store(objectBuffer, cull.size() * sizeof(GpuCullObject), cull.data());
+    store(transforms, models.size() * sizeof(glm::mat4), models.data());
+    store(inverses, inverseModels.size() * sizeof(glm::mat4), inverseModels.data());
+    store(lodObjects, lodObjectData.size() * sizeof(GpuLodObject), lodObjectData.data());
+    store(levels, levelData.size() * sizeof(GpuLevel), levelData.data());
+    store(bucketFirsts, firsts.size() * sizeof(GLuint), firsts.data());
+    store(commandBuffer, cull.size() * sizeof(DrawElementsIndirectCommand), nullptr);
+    store(counts, buckets.size() * sizeof(GLuint), nullptr);
+    store(params, sizeof(GpuCullParams), nullptr);
+    dirty = false;
+  }
+
+  // Fills the command ranges with the objects (and meshlets) that pass the frustum, their normal
+  // cone and, if `pyramid` holds the previous frame, the occlusion test. Levels of detail are
+  // picked for `camera` with at most `lodThreshold` pixels of error. Without `culling` only the
+  // normal cones are tested, as in RenderPass::appendClusters. Needs the camera block bound.
+  void cull(const DepthPyramid* pyramid, const Camera& camera, float lodThreshold, bool culling) {
+    const bool occlusion = pyramid && pyramid->valid;
+
+    GpuCullParams p{
+        .prevViewProj = occlusion ? pyramid->viewProj : glm::mat4(1.0f),
+        .pyramid      = occlusion ? glm::vec4(pyramid->width, pyramid->height, pyramid->levels, 1)
+                                  : glm::vec4(0.0f),
+        .lod          = glm::vec4(camera.pixelsPerUnit(), lodThreshold, camera.nearZ, 0),
+        .objects      = glm::uvec4(cullCount, culling, 0, 0)};
+    gGLState.bindBuffer(GL_UNIFORM_BUFFER, params);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(p), &p);
+    gGLState.countUpload(sizeof(p));
+    pass.rebind(ComputeBinding::Kind::Texture, 0, occlusion ? pyramid->texture : 0);
+
+    // last frame's counters (and, without the count entry point, its commands) start over
+    const GLuint zero = 0;
+    gGLState.consume(GL_BUFFER, counts, GL_BUFFER_UPDATE_BARRIER_BIT);
+    if (!indirectCountSupported())
+      gGLState.consume(GL_BUFFER, commandBuffer, GL_BUFFER_UPDATE_BARRIER_BIT);
+    gGLState.flushBarriers();
+
+    gGLState.bindBuffer(GL_COPY_WRITE_BUFFER, counts);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (!indirectCountSupported()) {
+      gGLState.bindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+      glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+
+    if (cullCount)
+      pass.dispatch(pass.groupsFor(cullCount));
+  }
+
+  // One multi-draw per material range. Materials that are not ready draw their fallback.
+  void draw(GeometryHeap& heap, RenderStats& stats) {
+    if (!objectCount)
+      return;
+
+    gGLState.consume(GL_BUFFER, commandBuffer, GL_COMMAND_BARRIER_BIT);
+    gGLState.consume(GL_BUFFER, counts, GL_COMMAND_BARRIER_BIT);
+    gGLState.flushBarriers();
+
+    heap.reserveDrawIndices(objectCount);
+    gGLState.bindVertexArray(heap.vao);
+    gGLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, transforms);
+    gGLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (indirectCountSupported())
+      gGLState.bindBuffer(GL_PARAMETER_BUFFER, counts);
+
+    const PipelineState* lastPipeline = nullptr;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+      const Material* material = buckets[b].material;
+      while (material && !material->ready())
+        material = material->fallback;
+      if (!material)
+        continue;
+
+      if (material->pipeline != lastPipeline) {
+        lastPipeline = material->pipeline;
+        ++stats.programChanges;
+      }
+      material->bind();
+      ++stats.materialChanges;
+
+      const auto* first = reinterpret_cast<const void*>(buckets[b].firstCommand *
+                                                        sizeof(DrawElementsIndirectCommand));
+      if (indirectCountSupported())
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES,
+                                         GL_UNSIGNED_INT,
+                                         first,
+                                         static_cast<GLintptr>(b * sizeof(GLuint)),
+                                         static_cast<GLsizei>(buckets[b].commandCount),
+                                         0);
+      else
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, GL_UNSIGNED_INT, first, static_cast<GLsizei>(buckets[b].commandCount), 0);
+      ++stats.drawCalls;
+    }
+    stats.draws = objectCount; // candidates; the visible count stays on the GPU
+  }
+
+  void destroy() {
+    for (GLuint* buffer : buffers()) {
+      if (*buffer) {
+        glDeleteBuffers(1, buffer);
+        gGLState.forgetBuffer(*buffer);
+      }
+      *buffer = 0;
+    }
+    capacities = {};
+    dirty      = true;
+  }
+};
+
+struct RenderPassSpec {
+  Camera*                  camera = nullptr;
+  FrameUniform             frameUniform;
+  std::vector<Renderable*> objects;
+  bool                     sortDraws      = true;
+  bool                     culling        = true;
+  GeometryHeap*            heap           = nullptr;
+  bool                     gpuCulling     = false;
+  DepthPyramid*            depthPyramid   = nullptr;
+  bool                     clusterCulling = false;
+  float                    lodThreshold   = 1.0f;
+};
+
+struct RenderPass {
+  Camera*      camera = nullptr;
+  FrameUniform frameUniform;
+
+  std::vector<Renderable*> objects;
+  bool                     sortDraws = true;    // false: submit in insertion order
+  bool                     culling   = true;    // false: skip the frustum and occlusion tests
+  GeometryHeap*            heap      = nullptr; // set: multi-draw-indirect over this heap
+
+  // With a heap: cull and build the indirect commands in a compute pass instead. Occlusion is
+  // tested against depthPyramid when it holds a previous frame. Opaque materials only.
+  bool          gpuCulling   = false;
+  DepthPyramid* depthPyramid = nullptr;
+  GpuCuller     gpuCuller;
+
+  // With a heap: objects whose mesh has meshlets are culled and drawn per meshlet, against the
+  // frustum and, where the material culls back faces, the meshlet's normal cone.
+  bool clusterCulling = false;
+
+  // Meshes with levels of detail draw the coarsest one whose error projects to at most this many
+  // pixels on the camera's viewport; 0 keeps full detail. Meshlets only cover the full level.
+  float lodThreshold = 1.0f;
+
+  // Objects per culling / recording thread; smaller scenes stay on the calling thread.
+  static constexpr size_t kCullObjectsPerThread   = 16384;
+  static constexpr size_t kRecordObjectsPerThread = 8192;
+
+  CullSet                    cullSet;
+  std::vector<size_t>        cuts; // slice boundaries, reused by cullObjects and recordCommands
+  std::vector<CommandBuffer> commandBuffers;
+
+  std::vector<DrawItem> queue; // rebuilt every frame, reused to avoid reallocating
+  std::vector<DrawItem> sortScratch;
+  RenderStats           stats;
+
+  StreamBuffer           instances{GL_SHADER_STORAGE_BUFFER};
+  std::vector<glm::mat4> instanceModels;
+
+  StreamBuffer                             indirectCommands{GL_DRAW_INDIRECT_BUFFER};
+  std::vector<DrawElementsIndirectCommand> commands;
+  std::vector<IndirectBucket>              buckets;
+
+  void render() {
+    ASSERT(camera);
+
+    camera->updateMatrices();
+    frameUniform.beginFrame();
+    frameUniform.update(CameraBlock{.viewProj = camera->viewProj,
+                                    .view     = camera->view,
+                                    .proj     = camera->proj,
+                                    .eye      = camera->position,
+                                    .farZ     = camera->farZ});
+
+    if (heap && gpuCulling) {
+      submitGpuCulled();
+    } else {
+      buildQueue();
+      if (heap)
+        submitIndirect();
+      else
+        submit();
+    }
+
+    frameUniform.endFrame();
+  }
+
+  // The GPU-culled path keeps its own copy of the objects' bounds, transforms and materials; call
+  // this after adding, removing or moving any of them.
+  void invalidateObjects() { gpuCuller.dirty = true; }
+
+  // Transforms every object's bounds to world space and tests them against the camera frustum,
+  // filling cullSet.visible. Large scenes are split across threads. No GL calls.
+  void cullObjects() {
+    ASSERT(camera);
+
+    const size_t n = objects.size();
+    cullSet.resize(n);
+
+    const size_t slices = sliceCount(n, kCullObjectsPerThread);
+    cuts.clear();
+    for (size_t s = 0; s <= slices; ++s)
+      cuts.push_back(n * s / slices);
+
+    runSlices(cuts, [this](size_t, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        cullSet.store(i, objects[i]->mesh->bounds, objects[i]->transform);
+      cullSpheres(camera->frustum, cullSet, begin, end);
+    });
+  }
+
+  // Culls, keys and sorts the objects against the camera's current matrices. No GL calls.
+  void buildQueue() {
+    ASSERT(camera);
+
+    stats = {};
+    queue.clear();
+    queue.reserve(objects.size());
+
+    if (culling)
+      cullObjects();
+
+    const glm::vec3 eye     = camera->position;
+    const glm::vec3 forward = camera->forward();
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+      Renderable* r = objects[i];
+      ASSERT(r->mesh && r->material);
+
+      if (culling && !cullSet.visible[i]) {
+        ++stats.culled;
+        continue;
+      }
+
+      const Material* material = r->material;
+      while (material && !material->ready())
+        material = material->fallback;
+      if (!material)
+        continue; // still linking and nothing to stand in
+
+      float    viewDepth = glm::dot(glm::vec3(r->transform[3]) - eye, forward);
+      uint32_t depth     = SortKey::quantizeDepth(viewDepth, camera->nearZ, camera->farZ);
+
+      uint32_t lod = 0;
+      if (r->mesh->lods.size() > 1) {
+        const glm::vec4 sphere =
+            culling ? glm::vec4(cullSet.x[i], cullSet.y[i], cullSet.z[i], cullSet.radius[i])
+                    : worldSphere(r->mesh->bounds, r->transform);
+        lod = lodOf(*r, sphere);
+      }
+
+      queue.push_back({SortKey::make(material->layer,
+                                     material->pipeline->id,
+                                     material->sortId,
+                                     r->mesh->sortId,
+                                     depth),
+                       r,
+                       material,
+                       lod});
+    }
+
+    if (sortDraws)
+      radixSort(queue, sortScratch);
+  }
+
+  // Level of detail of `r` with world-space bounding sphere `sphere`: the error is measured where
+  // the sphere comes closest to the camera.
+  uint32_t lodOf(const Renderable& r, const glm::vec4& sphere) const {
+    const float distance =
+        std::max(glm::distance(glm::vec3(sphere), camera->position) - sphere.w, camera->nearZ);
+    return selectLod(
+        r.mesh->lods, maxScale(r.transform), distance, camera->pixelsPerUnit(), lodThreshold);
+  }
+
+  // Records the queue into command buffers in parallel, then replays them on this thread.
+  void submit() {
+    recordCommands();
+
+    instances.upload(std::span<const glm::mat4>(instanceModels));
+    gGLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, instances.buffer);
+    replayCommands();
+  }
+
+  // Splits the queue into slices at run boundaries and records each on its own thread. Every
+  // transform is packed into instanceModels at its queue index. No GL calls.
+  void recordCommands() {
+    const size_t n = queue.size();
+    instanceModels.resize(n);
+
+    auto sameRun = [this](size_t a, size_t b) {
+      return queue[a].object->mesh == queue[b].object->mesh &&
+             queue[a].material == queue[b].material && queue[a].lod == queue[b].lod;
+    };
+
+    const size_t slices = sliceCount(n, kRecordObjectsPerThread);
+    cuts.assign(1, 0);
+    for (size_t s = 1; s < slices; ++s) {
+      size_t cut = std::max(cuts.back(), n * s / slices);
+      while (cut > 0 && cut < n && sameRun(cut - 1, cut))
+        ++cut;
+      cuts.push_back(cut);
+    }
+    cuts.push_back(n);
+
+    commandBuffers.resize(slices);
+    runSlices(cuts, [this](size_t slice, size_t begin, size_t end) {
+      record(commandBuffers[slice], begin, end);
+    });
+
+    for (const CommandBuffer& cb : commandBuffers)
+      stats += cb.stats;
+  }
+
+  // Records queue[begin, end), rebinding only what changed since the previous draw. Slices are
+  // replayed in order, so a slice starts from the state the item before it left bound. Runs of
+  // objects sharing a mesh and material of an instanced program collapse into one instanced draw.
+  void record(CommandBuffer& cb, size_t begin, size_t end) {
+    cb.clear();
+
+    const DrawItem*      prev         = begin > 0 ? &queue[begin - 1] : nullptr;
+    const PipelineState* lastPipeline = prev ? prev->material->pipeline : nullptr;
+    const Material*      lastMaterial = prev ? prev->material : nullptr;
+    const Mesh*          lastMesh     = prev ? prev->object->mesh : nullptr;
+    uint32_t             lastLod      = prev ? prev->lod : 0;
+
+    for (size_t i = begin; i < end;) {
+      const Renderable& r        = *queue[i].object;
+      const Material*   material = queue[i].material;
+      const uint32_t    lod      = queue[i].lod;
+
+      if (material != lastMaterial) {
+        if (material->pipeline != lastPipeline) {
+          lastPipeline = material->pipeline;
+          cb.bindPipeline(lastPipeline);
+        }
+        cb.bindMaterial(material);
+        lastMaterial = material;
+      }
+
+      if (r.mesh != lastMesh || lod != lastLod) {
+        lastMesh = r.mesh;
+        lastLod  = lod;
+        cb.bindMesh(lastMesh, lastLod);
+      }
+
+      size_t runEnd = i + 1;
+      if (lastPipeline->program->instanced()) {
+        while (runEnd < end && queue[runEnd].object->mesh == r.mesh &&
+               queue[runEnd].material == material && queue[runEnd].lod == lod)
+          ++runEnd;
+        cb.setInstanceBase(static_cast<uint32_t>(i));
+      } else {
+        // per-object uniforms
+        cb.setModel(static_cast<uint32_t>(i));
+      }
+
+      for (size_t j = i; j < runEnd; ++j)
+        instanceModels[j] = queue[j].object->model();
+
+      cb.draw(static_cast<uint32_t>(runEnd - i),
+              static_cast<uint32_t>(r.mesh->lodIndexCount(lod)) / 3);
+      i = runEnd;
+    }
+  }
+
+  // Issues the recorded commands in slice order. The only pass over the queue that touches GL.
+  void replayCommands() const {
+    const Program* program = nullptr;
+    const Mesh*    mesh    = nullptr;
+    uint32_t       lod     = 0;
+
+    for (const CommandBuffer& cb : commandBuffers) {
+      for (const RenderCommand& cmd : cb.commands) {
+        switch (cmd.op) {
+          case RenderOp::BindPipeline:
+            program = cmd.pipeline->program;
+            cmd.pipeline->bind();
+            break;
+          case RenderOp::BindMaterial:
+            cmd.material->bindResources();
+            break;
+          case RenderOp::BindMesh:
+            mesh = cmd.mesh;
+            lod  = cmd.value;
+            gGLState.bindVertexArray(mesh->vao);
+            break;
+          case RenderOp::SetInstanceBase:
+            glUniform1i(program->instanceBase, static_cast<GLint>(cmd.value));
+            break;
+          case RenderOp::SetModel:
+            program->setMat4("u_Model"_uid, glm::value_ptr(instanceModels[cmd.value]));
+            break;
+          case RenderOp::Draw:
+            mesh->drawInstanced(static_cast<GLsizei>(cmd.value), lod);
+            break;
+        }
+      }
+    }
+  }
+
+  // Every object lives in `heap`. Runs of the same mesh and material become one indirect command
+  // whose baseInstance indexes the transforms; each material bucket is one multi-draw. Under
+  // clusterCulling, objects with meshlets get one command per visible meshlet instead.
+  void submitIndirect() {
+    ASSERT(heap);
+
+    instanceModels.clear();
+    commands.clear();
+    buckets.clear();
+
+    const Mesh*     lastMesh     = nullptr;
+    const Material* lastMaterial = nullptr;
+    uint32_t        lastLod      = 0;
+
+    for (const DrawItem& item : queue) {
+      const Renderable& r = *item.object;
+      ASSERT(r.mesh->heapId == heap->id);
+
+      if (item.material != lastMaterial) {
+        buckets.push_back({item.material, static_cast<uint32_t>(commands.size()), 0});
+        lastMesh = nullptr;
+      }
+      lastMaterial = item.material;
+
+      if (clusterCulling && !r.mesh->meshlets.empty() && item.lod == 0) {
+        const auto slot = static_cast<GLuint>(instanceModels.size());
+        instanceModels.push_back(r.model());
+        buckets.back().commandCount += appendClusters(r, *item.material, slot);
+        ++stats.meshChanges;
+        lastMesh = nullptr; // the next object of this mesh starts its own command
+        continue;
+      }
+      if (r.mesh != lastMesh || item.lod != lastLod) {
+        commands.push_back({.count         = static_cast<GLuint>(r.mesh->lodIndexCount(item.lod)),
+                            .instanceCount = 0,
+                            .firstIndex    = r.mesh->lodFirstIndex(item.lod),
+                            .baseVertex    = r.mesh->baseVertex,
+                            .baseInstance  = static_cast<GLuint>(instanceModels.size())});
+        ++buckets.back().commandCount;
+        ++stats.meshChanges;
+      }
+
+      ++commands.back().instanceCount;
+      stats.triangles += commands.back().count / 3;
+      instanceModels.push_back(r.model());
+      lastMesh = r.mesh;
+      lastLod  = item.lod;
+    }
+
+    if (commands.empty())
+      return;
+
+    instances.upload(std::span<const glm::mat4>(instanceModels));
+    gGLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, instances.buffer);
+    indirectCommands.upload(std::span<const DrawElementsIndirectCommand>(commands));
+    heap->reserveDrawIndices(instanceModels.size());
+
+    gGLState.bindVertexArray(heap->vao);
+    const PipelineState* lastPipeline = nullptr;
+
+    for (const IndirectBucket& bucket : buckets) {
+      if (!bucket.commandCount)
+        continue; // every meshlet culled
+      if (bucket.material->pipeline != lastPipeline) {
+        lastPipeline = bucket.material->pipeline;
+        ++stats.programChanges;
+      }
+      bucket.material->bind();
+      ++stats.materialChanges;
+
+      glMultiDrawElementsIndirect(
+          GL_TRIANGLES,
+          GL_UNSIGNED_INT,
+          reinterpret_cast<const void*>(bucket.firstCommand * sizeof(DrawElementsIndirectCommand)),
+          static_cast<GLsizei>(bucket.commandCount),
+          0);
+      ++stats.drawCalls;
+    }
+    stats.draws = static_cast<uint32_t>(instanceModels.size());
+  }
+
+  // Appends an indirect command for every meshlet of `r` that is inside the frustum and, when
+  // `material` culls back faces, not entirely back-facing. `slot` indexes r's transform. Returns
+  // the number of commands appended.
+  uint32_t appendClusters(const Renderable& r, const Material& material, GLuint slot) {
+    const Mesh&     mesh  = *r.mesh;
+    const bool      cones = culledBackFaces(material.state.raster, r.transform);
+    const glm::vec3 eye   = glm::inverse(r.transform) * glm::vec4(camera->position, 1.0f);
+    const glm::vec4 whole = worldSphere(mesh.bounds, r.transform);
+
+    // an object wholly inside the frustum skips the per-meshlet plane tests
+    const bool planes  = culling && frustumDistance(camera->frustum, whole) < whole.w;
+    auto       outside = [&](const Meshlet& meshlet) {
+      const glm::vec4 sphere = worldSphere(meshlet.sphere, r.transform);
+      return frustumDistance(camera->frustum, sphere) < -sphere.w;
+    };
+
+    uint32_t appended = 0;
+    for (const Meshlet& meshlet : mesh.meshlets) {
+      if ((cones && backFacing(meshlet, eye)) || (planes && outside(meshlet))) {
+        ++stats.clustersCulled;
+        continue;
+      }
+      commands.push_back({.count         = meshlet.indexCount,
+                          .instanceCount = 1,
+                          .firstIndex    = mesh.firstIndex + meshlet.firstIndex,
+                          .baseVertex    = mesh.baseVertex,
+                          .baseInstance  = slot});
+      stats.triangles += meshlet.indexCount / 3;
+      ++appended;
+    }
+    return appended;
+  }
+
+  // Culls on the GPU and draws what survives without reading anything back: stats.draws counts
+  // the candidates and stats.culled stays 0.
+  void submitGpuCulled() {
+    ASSERT(heap);
+
+    stats = {};
+    if (gpuCuller.dirty)
+      gpuCuller.upload(objects, *heap, frameUniform.binding, clusterCulling);
+    gpuCuller.cull(depthPyramid, *camera, lodThreshold, culling);
+    gpuCuller.draw(*heap, stats);
+  }
+};
+struct RenderPassPipe {
+  RenderPassSpec spec;
+
+  RenderPassPipe()                            = default;
+  RenderPassPipe(RenderPassPipe&&)            = default;
+  RenderPassPipe& operator=(RenderPassPipe&&) = default;
+
+  RenderPassPipe(const RenderPassPipe&)            = delete;
+  RenderPassPipe& operator=(const RenderPassPipe&) = delete;
+
+  RenderPassPipe&& camera(Camera* cam) && {
+    spec.camera = cam;
+    return std::move(*this);
+  }
+
+  RenderPassPipe&& frameUniform(FrameUniform&& fu) && {
+    spec.frameUniform = std::move(fu);
+    return std::move(*this);
+  }
+
+  RenderPassPipe&& add(Renderable& r) && {
+    spec.objects.push_back(&r);
+    return std::move(*this);
+  }
+
+  RenderPassPipe&& add(std::span<Renderable> rs) && {
+    for (auto& r : rs)
+      spec.objects.push_back(&r);
+    return std::move(*this);
+  }
+
+  RenderPassPipe&& sorted(bool enable) && {
+    spec.sortDraws = enable;
+    return std::move(*this);
+  }
+
+  RenderPassPipe&& culling(bool enable) && {
+    spec.culling = enable;
+    return std::move(*this);
+  }
+
+  // Submit with glMultiDrawElementsIndirect; every added Renderable's mesh must come from `heap`.
+  RenderPassPipe&& indirect(GeometryHeap& heap) && {
+    spec.heap = &heap;
+    return std::move(*this);
+  }
+
+  // Cull in a compute pass that writes the indirect commands; needs indirect() and opaque
+  // materials. With `occlusion`, also skips objects hidden behind the depth the app last built
+  // into it.
+  RenderPassPipe&& gpuCulling(DepthPyramid* occlusion = nullptr) && {
+    spec.gpuCulling   = true;
+    spec.depthPyramid = occlusion;
+    return std::move(*this);
+  }
+
+  // Cull and draw meshes that carry meshlets (see MeshletBuilder) per meshlet; needs indirect().
+  // Works with and without gpuCulling.
+  RenderPassPipe&& clusterCulling(bool enable = true) && {
+    spec.clusterCulling = enable;
+    return std::move(*this);
+  }
+
+  // Pixels of projected error a mesh's level of detail (see MeshSimplifier) may show; 0 draws
+  // every mesh at full detail.
+  RenderPassPipe&& lod(float pixels) && {
+    spec.lodThreshold = pixels;
+    return std::move(*this);
+  }
+
+  RenderPass build() && {
+    ASSERT_ALWAYS(spec.camera);
+    ASSERT_ALWAYS(spec.frameUniform.buffer);
+    ASSERT_ALWAYS(!spec.gpuCulling || spec.heap);
+    ASSERT_ALWAYS(!spec.clusterCulling || spec.heap);
+
+    return RenderPass{.camera         = spec.camera,
+                      .frameUniform   = std::move(spec.frameUniform),
+                      .objects        = std::move(spec.objects),
+                      .sortDraws      = spec.sortDraws,
+                      .culling        = spec.culling,
+                      .heap           = spec.heap,
+                      .gpuCulling     = spec.gpuCulling,
+                      .depthPyramid   = spec.depthPyramid,
+                      .clusterCulling = spec.clusterCulling,
+                      .lodThreshold   = spec.lodThreshold};
+  }
+};
+
+#endif
\ No newline at end of file